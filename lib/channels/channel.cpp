@@ -1,7 +1,24 @@
 #include "channels/channel.h"
-
-Channel::Channel(const SocketAddress local_address) : address(local_address)
+#include "core/trace.h"
+
+Channel::Channel(const SocketAddress local_address, size_t batch_size)
+    : address(local_address),
+      batch(batch_size),
+      batch_headers(batch_size),
+      batch_buffers(batch_size),
+      batch_origins(batch_size)
 {
+    for (size_t i = 0; i < batch_size; i++)
+    {
+        batch_buffers[i].iov_base = (char *)&batch[i].data;
+        batch_buffers[i].iov_len = sizeof(PacketData);
+
+        batch_headers[i].msg_hdr = msghdr{};
+        batch_headers[i].msg_hdr.msg_iov = &batch_buffers[i];
+        batch_headers[i].msg_hdr.msg_iovlen = 1;
+        batch_headers[i].msg_hdr.msg_name = &batch_origins[i];
+    }
+
     open_socket();
 }
 
@@ -51,7 +68,7 @@ void Channel::shutdown_socket() const
     shutdown(socket_descriptor, SHUT_RDWR);
 }
 
-void Channel::send(Packet packet)
+bool Channel::send(Packet packet)
 {
     [[maybe_unused]] const PacketHeader& header = packet.data.header;
     const SocketAddress destination = packet.meta.destination;
@@ -74,9 +91,15 @@ void Channel::send(Packet packet)
     if (bytes_sent < 0)
     {
         log_warn("Unable to send message to ", destination.to_string(), ".");
-        return;
+        return false;
     }
-    log_info("Sent packet ", packet.to_string(PacketFormat::SENT), " (", bytes_sent, " bytes).");
+    if (Trace::enabled())
+    {
+        Trace::record(TraceEvent::PACKET_SENT, packet);
+        return true;
+    }
+    log_info("Sent packet ", packet.summary(PacketFormat::SENT), " (", bytes_sent, " bytes).");
+    return true;
 }
 
 Packet Channel::receive()
@@ -104,3 +127,30 @@ Packet Channel::receive()
 
     return packet;
 }
+
+std::span<Packet> Channel::receive_many()
+{
+    // O kernel sobrescreve o tamanho do endereço de origem a cada leitura.
+    for (mmsghdr& header : batch_headers)
+        header.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+
+    log_trace("Waiting to receive data.");
+    int received = recvmmsg(socket_descriptor, batch_headers.data(), batch_headers.size(), MSG_WAITFORONE, nullptr);
+
+    if (received <= 0)
+        throw std::runtime_error("Socket closed.");
+
+    for (int i = 0; i < received; i++)
+    {
+        // Assim como no recvfrom, uma leitura vazia indica que o socket foi fechado.
+        if (!batch_headers[i].msg_len)
+            throw std::runtime_error("Socket closed.");
+
+        batch[i].meta = PacketMetadata{};
+        batch[i].meta.origin = SocketAddress::from(batch_origins[i]);
+        batch[i].meta.destination = address;
+        batch[i].meta.message_length = batch_headers[i].msg_len - sizeof(PacketHeader);
+    }
+
+    return std::span<Packet>(batch.data(), received);
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <span>
 #include <vector>
 #include <unordered_map>
 #include <netinet/in.h>
@@ -11,22 +12,42 @@
 #include "core/message.h"
 #include "core/packet.h"
 #include "core/node.h"
+#include "core/constants.h"
 
 class Channel
 {
 public:
-    explicit Channel(SocketAddress local_address);
+    explicit Channel(SocketAddress local_address, size_t batch_size = RECEIVE_BATCH_SIZE);
     ~Channel();
 
-    void send(Packet packet);
+    /**
+     * Retorna false se o pacote não pôde ser enviado.
+    */
+    bool send(Packet packet);
     Packet receive();
 
+    /**
+     * Espera pelo menos um pacote e lê, com uma única chamada de sistema,
+     * até `batch_size` pacotes que já estejam no socket. Os pacotes ficam em
+     * um lote do próprio canal, válido até a próxima chamada; só a thread de
+     * recepção deve chamar.
+    */
+    std::span<Packet> receive_many();
+
     void shutdown_socket() const;
 private:
     SocketAddress address;
     Packet buffer;
     std::mutex send_mutex;
 
+    /**
+     * Lote do recvmmsg, alocado e ligado aos cabeçalhos uma única vez.
+    */
+    std::vector<Packet> batch;
+    std::vector<mmsghdr> batch_headers;
+    std::vector<iovec> batch_buffers;
+    std::vector<sockaddr_in> batch_origins;
+
     int socket_descriptor = -1;
     sockaddr_in in_address{};
     sockaddr_in out_address{};
@@ -1,36 +1,110 @@
 #include "communication/connection.h"
 #include "pipeline/pipeline.h"
+#include "communication/sender_pool.h"
+#include "core/trace.h"
 #include "utils/uuid.h"
 
 Connection::Connection(
     Node local_node,
     Node remote_node,
     Pipeline &pipeline,
-    Buffer<Message> &application_buffer,
-    BufferSet<std::string> &connection_update_buffer) : pipeline(pipeline),
-                                                        application_buffer(application_buffer),
-                                                        local_node(local_node),
-                                                        remote_node(remote_node),
-                                                        connection_update_buffer(connection_update_buffer)
-{
-    observe_pipeline();
+    Buffer<MessageHandle> &application_buffer,
+    SenderPool &sender_pool,
+    std::shared_ptr<const TransmissionConfig> config,
+    ConnectionDescriptor descriptor) : pipeline(pipeline),
+                                       application_buffer(application_buffer),
+                                       local_node(local_node),
+                                       remote_node(remote_node),
+                                       config(config),
+                                       state(descriptor.state),
+                                       sender_pool(sender_pool),
+                                       next_number(descriptor.next_number),
+                                       expected_number(descriptor.expected_number),
+                                       last_activity(DateUtils::monotonic_us())
+{
+    sender_worker = sender_pool.assign();
+}
+
+const std::map<ConnectionState, void (Connection::*)(Packet)> Connection::packet_receive_handlers = {
+    {ESTABLISHED, &Connection::established},
+    {SYN_SENT, &Connection::syn_sent},
+    {SYN_RECEIVED, &Connection::syn_received},
+    {CLOSED, &Connection::closed},
+    {FIN_WAIT, &Connection::fin_wait},
+    {LAST_ACK, &Connection::last_ack}};
+
+const std::map<ConnectionState, std::string> Connection::state_names = {
+    {ESTABLISHED, "established"},
+    {SYN_SENT, "syn_sent"},
+    {SYN_RECEIVED, "syn_received"},
+    {CLOSED, "closed"},
+    {FIN_WAIT, "fin_wait"},
+    {LAST_ACK, "last_ack"}};
+
+Connection::~Connection()
+{
+    retired = true;
+
+    while (!sender_pool.unschedule(this))
+        std::this_thread::yield();
+}
+
+void Connection::close()
+{
+    if (retired.exchange(true))
+        return;
+
+    log_info("Closing connection with node ", remote_node.get_id(), ", removed from the group.");
+
+    if (handshake_timer_id != -1)
+    {
+        timer.cancel(handshake_timer_id);
+        handshake_timer_id = -1;
+    }
+
+    cancel_transmissions();
 }
 
-void Connection::observe_pipeline()
+bool Connection::suspend(uint64_t idle_timeout_ms, ConnectionDescriptor& descriptor)
 {
-    obs_message_defragmentation_is_complete.on(std::bind(&Connection::message_defragmentation_is_complete, this, _1));
-    obs_transmission_complete.on(std::bind(&Connection::transmission_complete, this, _1));
-    obs_transmission_fail.on(std::bind(&Connection::transmission_fail, this, _1));
-    pipeline.attach(obs_message_defragmentation_is_complete);
-    pipeline.attach(obs_transmission_complete);
-    pipeline.attach(obs_transmission_fail);
+    if (DateUtils::monotonic_us() - last_activity.load() < idle_timeout_ms * 1000)
+        return false;
+
+    // Ocupada com update() ou com o timeout do handshake não está ociosa.
+    // Esperar aqui inverteria a ordem dos locks: quem chama segura o lock
+    // do GroupRegistry, que update() pode pedir depois de mutex_state.
+    std::unique_lock lock(mutex_state, std::try_to_lock);
+    if (!lock.owns_lock())
+        return false;
+
+    if ((state != ESTABLISHED && state != CLOSED) || handshake_timer_id != -1 || active_transmission || zero_window_advertised)
+        return false;
+
+    mutex_transmissions.lock();
+    bool has_transmissions = !transmissions.empty();
+    mutex_transmissions.unlock();
+
+    mutex_packets.lock();
+    bool has_packets = !packets_to_send.empty();
+    mutex_packets.unlock();
+
+    if (has_transmissions || has_packets)
+        return false;
+
+    if (retired.exchange(true))
+        return false;
+
+    descriptor = ConnectionDescriptor{
+        state : state,
+        next_number : next_number,
+        expected_number : expected_number
+    };
+    return true;
 }
 
 void Connection::message_defragmentation_is_complete(const MessageDefragmentationIsComplete &event)
 {
     Packet &packet = event.packet;
-    if (packet.meta.origin != remote_node.get_address())
-        return;
 
     if (application_buffer.can_produce())
         pipeline.notify(ForwardDefragmentedMessage(packet));
@@ -79,11 +153,13 @@ void Connection::connect()
 
 void Connection::set_timeout()
 {
-    handshake_timer_id = timer.add(HANDSHAKE_TIMEOUT, std::bind(&Connection::connection_timeout, this));
+    handshake_timer_id = timer.add(config->handshake_timeout, std::bind(&Connection::connection_timeout, this));
 }
 
 void Connection::connection_timeout()
 {
+    std::lock_guard lock(mutex_state);
+
     log_warn("Unable to establish connection with node ", remote_node.get_id());
     change_state(CLOSED);
     handshake_timer_id = -1;
@@ -98,7 +174,7 @@ bool Connection::disconnect()
     log_trace("disconnect: sending FIN.");
     change_state(FIN_WAIT);
     send_flag(FIN);
-    int timer_id = timer.add(HANDSHAKE_TIMEOUT, std::bind(&Connection::connection_timeout, this));
+    int timer_id = timer.add(config->handshake_timeout, std::bind(&Connection::connection_timeout, this));
 
     std::unique_lock lock(mutex);
     while (state != CLOSED)
@@ -219,25 +295,35 @@ void Connection::established(Packet p)
 
     if (p.data.header.is_ack())
     {
-        log_debug("Received ", p.to_string(PacketFormat::RECEIVED), "; removing from list of packets with pending ACKs.");
+        log_debug("Received ", p.summary(PacketFormat::RECEIVED), "; removing from list of packets with pending ACKs.");
         pipeline.notify(PacketAckReceived(p));
         return;
     }
+
+    if (p.data.header.is_window_update())
+    {
+        log_debug("Received ", p.summary(PacketFormat::RECEIVED), "; node ", remote_node.get_id(), " has room for ", p.get_window(), " messages.");
+        pipeline.notify(WindowUpdateReceived(p));
+        return;
+    }
     uint32_t message_number = p.data.header.get_message_number();
 
     if (message_number > expected_number)
     {
-        log_debug("Received ", p.to_string(PacketFormat::RECEIVED), " that expects confirmation, but message number ", message_number, " is higher than the expected ", expected_number, "; ignoring it.");
+        log_debug("Received ", p.summary(PacketFormat::RECEIVED), " that expects confirmation, but message number ", message_number, " is higher than the expected ", expected_number, "; ignoring it.");
+        pipeline.get_counters().add(remote_node.get_index(), Counter::REORDER_DROPS);
         return;
     }
 
     if (p.data.header.get_message_type() == MessageType::APPLICATION && !application_buffer.can_produce())
     {
-        log_warn("Application buffer is full; ignoring packet.");
+        log_warn("Application buffer is full; refusing ", p.summary(PacketFormat::RECEIVED), " with a zero window.");
+        pipeline.get_counters().add(remote_node.get_index(), Counter::BUFFER_FULL_DROPS);
+        send_window_update(p);
         return;
     }
 
-    log_debug("Received ", p.to_string(PacketFormat::RECEIVED), " that expects confirmation; sending ACK.");
+    log_debug("Received ", p.summary(PacketFormat::RECEIVED), " that expects confirmation; sending ACK.");
     send_ack(p);
 }
 
@@ -281,7 +367,7 @@ void Connection::last_ack(Packet p)
     }
 }
 
-void Connection::send_flag(unsigned char flags)
+Packet Connection::create_flag_packet(unsigned char flags)
 {
     PacketHeader header;
     memset(&header, 0, sizeof(PacketHeader));
@@ -296,12 +382,69 @@ void Connection::send_flag(unsigned char flags)
     Packet packet;
     packet.meta.origin = local_node.get_address();
     packet.meta.destination = remote_node.get_address();
+    packet.meta.peer = remote_node.get_index();
     packet.data = data;
 
-    transmit(packet);
+    return packet;
+}
+
+void Connection::send_flag(unsigned char flags)
+{
+    transmit(create_flag_packet(flags));
 }
 
 void Connection::send_ack(Packet packet)
+{
+    Packet ack_packet = create_reply(packet);
+    ack_packet.data.header.ack = 1;
+
+    transmit_with_window(ack_packet, application_buffer.available());
+}
+
+void Connection::send_window_update(Packet packet)
+{
+    Packet update_packet = create_reply(packet);
+    update_packet.data.header.wnd = 1;
+
+    // A recusa sempre anuncia janela zero, que é o que faz o nó devolver o
+    // fragmento à fila; o espaço liberado depois chega por window_opened().
+    transmit_with_window(update_packet, 0);
+}
+
+/**
+ * Envia o pacote anunciando `window`. Uma janela zero pede ao buffer da
+ * aplicação um aviso de espaço, para que window_opened() reabra a janela
+ * do nó assim que a aplicação consumir.
+*/
+void Connection::transmit_with_window(Packet packet, uint32_t window)
+{
+    if (!window)
+    {
+        zero_window_advertised = true;
+        application_buffer.notify_on_space();
+    }
+
+    packet.set_window(window);
+    transmit(packet);
+
+    // O espaço pode ter sido liberado antes do pedido de aviso.
+    if (!window && application_buffer.available())
+        window_opened();
+}
+
+void Connection::window_opened()
+{
+    if (!zero_window_advertised.exchange(false) || state != ESTABLISHED)
+        return;
+
+    Packet update_packet = create_flag_packet(WND);
+    update_packet.set_window(application_buffer.available());
+
+    log_debug("Application buffer has room again; sending window ", update_packet.get_window(), " to node ", remote_node.get_id(), ".");
+    transmit(update_packet);
+}
+
+Packet Connection::create_reply(Packet packet)
 {
     PacketData data;
     memset(&data, 0, sizeof(PacketData));
@@ -310,10 +453,11 @@ void Connection::send_ack(Packet packet)
                    msg_num : packet.data.header.msg_num,
                    fragment_num : packet.data.header.fragment_num,
                    checksum : 0,
-                   ack : 1,
+                   ack : 0,
                    rst : 0,
                    syn : 0,
                    fin : 0,
+                   wnd : 0,
                    reserved : 0,
                    end : 0,
                    type : MessageType::CONTROL
@@ -323,14 +467,13 @@ void Connection::send_ack(Packet packet)
         origin : local_node.get_address(),
         destination : remote_node.get_address(),
         message_length : 0,
-        expects_ack : 0
+        expects_ack : 0,
+        peer : remote_node.get_index()
     };
-    Packet ack_packet = {
+    return Packet{
         data : data,
         meta : meta
     };
-
-    transmit(ack_packet);
 }
 
 bool Connection::close_on_rst(Packet p)
@@ -396,27 +539,46 @@ void Connection::change_state(ConnectionState new_state)
 }
 
 bool Connection::enqueue(Transmission &transmission)
+{
+    Transmission* batch[] = {&transmission};
+    return enqueue_many(batch) == 1;
+}
+
+std::size_t Connection::enqueue_many(std::span<Transmission*> batch)
 {
     mutex_transmissions.lock();
 
-    if (transmissions.size() >= MAX_ENQUEUED_TRANSMISSIONS) {
-        mutex_transmissions.unlock();
-        return false;
-    }
-    
-    transmissions.push_back(&transmission);
+    std::size_t free = transmissions.size() < config->max_enqueued_transmissions
+        ? config->max_enqueued_transmissions - transmissions.size()
+        : 0;
+    std::size_t count = std::min(free, batch.size());
+
+    transmissions.insert(transmissions.end(), batch.begin(), batch.begin() + count);
+    last_activity = DateUtils::monotonic_us();
 
     mutex_transmissions.unlock();
 
-    log_debug("Enqueued transmission ", transmission.uuid, " on connection of node ", transmission.receiver_id);
+    if (!count)
+        return 0;
+
+    log_debug("Enqueued ", count, " transmission(s) on connection of node ", remote_node.get_id());
 
     request_update();
-    return true;
+    return count;
+}
+
+std::size_t Connection::get_queued_transmissions()
+{
+    std::lock_guard lock(mutex_transmissions);
+    return transmissions.size();
 }
 
 void Connection::request_update()
 {
-    connection_update_buffer.produce(remote_node.get_id());
+    if (retired.load(std::memory_order_acquire))
+        return;
+
+    sender_pool.schedule(this);
 }
 
 void Connection::complete_transmission()
@@ -466,6 +628,8 @@ void Connection::cancel_transmissions()
 
 void Connection::update()
 {
+    std::lock_guard lock(mutex_state);
+
     log_trace("Updating connection with node ", remote_node.get_id());
 
     mutex_packets.lock();
@@ -507,30 +671,36 @@ void Connection::send(Packet packet)
 
 void Connection::receive(Packet packet)
 {
-    packet_receive_handlers.at(state)(packet);
+    last_activity = DateUtils::monotonic_us();
+    (this->*packet_receive_handlers.at(state))(packet);
 }
-void Connection::receive(Message message)
+void Connection::receive(MessageHandle message)
 {
+    last_activity = DateUtils::monotonic_us();
+
     if (state != ESTABLISHED)
     {
-        log_warn("Connection is not established; dropping message ", message.to_string(), ".");
+        log_warn("Connection is not established; dropping message ", message->to_string(), ".");
         return;
     }
 
-    if (message.number < expected_number)
+    if (message->number < expected_number)
     {
-        log_warn("Message ", message.to_string(), " was already received; dropping it.");
+        log_warn("Message ", message->to_string(), " was already received; dropping it.");
         return;
     }
 
-    if (message.number > expected_number)
+    if (message->number > expected_number)
     {
-        log_warn("Message ", message.to_string(), " is unexpected, current number expected is ", expected_number, "; dropping it.");
+        log_warn("Message ", message->to_string(), " is unexpected, current number expected is ", expected_number, "; dropping it.");
+        pipeline.get_counters().add(remote_node.get_index(), Counter::REORDER_DROPS);
         return;
     }
 
     expected_number++;
-    application_buffer.produce(message);
+    Trace::record(TraceEvent::MESSAGE_DELIVERED, message->peer, message->number, 0, 0, message->length);
+    application_buffer.produce(std::move(message));
+    pipeline.notify(MessageDelivered());
 }
 
 void Connection::transmit(Packet p)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <map>
@@ -9,6 +10,7 @@
 #include <vector>
 #include <functional>
 #include <exception>
+#include <span>
 
 #include "utils/config.h"
 #include "utils/format.h"
@@ -17,15 +19,19 @@
 #include "utils/log.h"
 #include "core/node.h"
 #include "core/buffer.h"
+#include "core/message_pool.h"
+#include "core/ready_queue.h"
 #include "utils/date.h"
 #include "core/constants.h"
 #include "core/event.h"
 #include "utils/observer.h"
 #include "communication/transmission.h"
+#include "pipeline/transmission/transmission_config.h"
 
 using namespace std::placeholders;
 
 class Pipeline;
+class SenderPool;
 
 enum ConnectionState
 {
@@ -37,15 +43,41 @@ enum ConnectionState
     LAST_ACK = 5
 };
 
+/**
+ * O que sobra de uma conexão ociosa depois de desfeita: o suficiente para
+ * recriá-la no próximo contato sem um novo handshake.
+*/
+struct ConnectionDescriptor
+{
+    ConnectionState state = CLOSED;
+    uint32_t next_number = 0;
+    uint32_t expected_number = 0;
+};
+
 class Connection
 {
+public:
+    /**
+     * Gancho da fila de conexões com atualizações pendentes.
+    */
+    ReadyHook<Connection> ready_hook;
+
+    using UpdateQueue = ReadyQueue<Connection, &Connection::ready_hook>;
+
+    /**
+     * Worker do SenderPool em cuja fila esta conexão é agendada.
+    */
+    uint32_t sender_worker = 0;
+
 private:
     Pipeline &pipeline;
-    Buffer<Message> &application_buffer;
+    Buffer<MessageHandle> &application_buffer;
 
     Node local_node;
     Node remote_node;
 
+    std::shared_ptr<const TransmissionConfig> config;
+
     ConnectionState state = CLOSED;
     std::condition_variable state_change;
 
@@ -56,34 +88,48 @@ private:
     // Para isso, vai ser necessário adaptar para ter um TransmissionQueue por ato de send
     // ou um TransmissionQueue só suportar mensagem + pacotes não relacionados
     std::vector<Packet> packets_to_send;
-    BufferSet<std::string>& connection_update_buffer;
+    SenderPool& sender_pool;
 
     uint32_t next_number = 0;
     uint32_t expected_number = 0;
 
-    Timer timer{};
     int handshake_timer_id = -1;
 
+    /**
+     * O nó saiu do grupo ou a conexão foi desfeita por ociosidade: ela não é
+     * mais agendada e só espera o último dono soltá-la.
+    */
+    std::atomic<bool> retired{false};
+
+    /**
+     * O nó recebeu uma janela zero e só volta a enviar com uma atualização
+     * (ou com as sondas, mais lentas).
+    */
+    std::atomic<bool> zero_window_advertised{false};
+
+    /**
+     * Última vez, em DateUtils::monotonic_us(), que a conexão enfileirou ou
+     * recebeu algo.
+    */
+    std::atomic<uint64_t> last_activity;
+
     std::mutex mutex;
+    /**
+     * Serializa as mudanças de estado feitas sem uma referência à conexão
+     * (update() no SenderPool e o timeout do handshake) com suspend(). As
+     * que chegam pelo receptor e pelos eventos do pipeline já seguram uma
+     * referência, o que basta para suspend() não desfazer a conexão.
+    */
+    std::mutex mutex_state;
     std::mutex mutex_transmissions;
     std::mutex mutex_packets;
 
 
-    const std::map<ConnectionState, std::function<void(Packet)>> packet_receive_handlers = {
-        {ESTABLISHED, std::bind(&Connection::established, this, _1)},
-        {SYN_SENT, std::bind(&Connection::syn_sent, this, _1)},
-        {SYN_RECEIVED, std::bind(&Connection::syn_received, this, _1)},
-        {CLOSED, std::bind(&Connection::closed, this, _1)},
-        {FIN_WAIT, std::bind(&Connection::fin_wait, this, _1)},
-        {LAST_ACK, std::bind(&Connection::last_ack, this, _1)}};
-
-    const std::map<ConnectionState, std::string> state_names = {
-        {ESTABLISHED, "established"},
-        {SYN_SENT, "syn_sent"},
-        {SYN_RECEIVED, "syn_received"},
-        {CLOSED, "closed"},
-        {FIN_WAIT, "fin_wait"},
-        {LAST_ACK, "last_ack"}};
+    /**
+     * Compartilhadas por todas as conexões, que podem ser muitas.
+    */
+    static const std::map<ConnectionState, void (Connection::*)(Packet)> packet_receive_handlers;
+    static const std::map<ConnectionState, std::string> state_names;
 
     enum // TODO: mover isso para o Packet e fazer ele mesmo definir as flags
     {
@@ -91,6 +137,7 @@ private:
         RST = 0x02,
         SYN = 0x04,
         FIN = 0x08,
+        WND = 0x10,
     };
 
     void transmit(Packet);
@@ -105,8 +152,12 @@ private:
     void fin_wait(Packet p);
     void last_ack(Packet p);
 
+    Packet create_flag_packet(unsigned char flags);
     void send_flag(unsigned char flags);
     void send_ack(Packet packet);
+    void send_window_update(Packet packet);
+    void transmit_with_window(Packet packet, uint32_t window);
+    Packet create_reply(Packet packet);
 
     bool close_on_rst(Packet p);
     bool rst_on_syn(Packet p);
@@ -123,27 +174,58 @@ private:
     std::string get_current_state_name();
     void change_state(ConnectionState new_state);
 
-    void observe_pipeline();
-
-    Observer<MessageDefragmentationIsComplete> obs_message_defragmentation_is_complete;
-    Observer<TransmissionComplete> obs_transmission_complete;
-    Observer<TransmissionFail> obs_transmission_fail;
-    
-    void message_defragmentation_is_complete(const MessageDefragmentationIsComplete& event);
-    void transmission_complete(const TransmissionComplete& event);
-    void transmission_fail(const TransmissionFail& event);
+    /**
+     * Último membro, para ser destruído primeiro: o destrutor do Timer
+     * cancela os timers da conexão e espera o callback em execução.
+    */
+    Timer timer{};
 
 public:
     Connection(
         Node local_node,
         Node remote_node,
         Pipeline &pipeline,
-        Buffer<Message> &application_buffer,
-        BufferSet<std::string>& connection_update_buffer
+        Buffer<MessageHandle> &application_buffer,
+        SenderPool& sender_pool,
+        std::shared_ptr<const TransmissionConfig> config,
+        ConnectionDescriptor descriptor = {}
     );
 
+    /**
+     * Tira a conexão da fila do SenderPool, que guarda ponteiros para ela,
+     * esperando o worker terminar se ela estiver sendo atualizada.
+    */
+    ~Connection();
+
+    /**
+     * Encerra a conexão de um nó removido do grupo: as transmissões
+     * pendentes falham e a conexão deixa de ser agendada.
+    */
+    void close();
+
+    /**
+     * Desfaz a conexão se ela está ociosa há `idle_timeout_ms`: nada
+     * enfileirado, nada a enviar e nenhum handshake em andamento. Nesse caso
+     * preenche `descriptor`, deixa de ser agendada e retorna true. Quem
+     * chama deve ser o único dono da conexão; a verificação e a cópia do
+     * estado são feitas com mutex_state.
+    */
+    bool suspend(uint64_t idle_timeout_ms, ConnectionDescriptor& descriptor);
+
     bool enqueue(Transmission& transmission);
 
+    /**
+     * Enfileira várias transmissões com uma aquisição do lock e um único
+     * pedido de atualização. Retorna quantas, a partir do início, couberam
+     * na fila.
+    */
+    std::size_t enqueue_many(std::span<Transmission*> batch);
+
+    /**
+     * Mensagens enfileiradas que ainda não começaram a ser enviadas.
+    */
+    std::size_t get_queued_transmissions();
+
     void request_update();
 
     void update();
@@ -152,5 +234,18 @@ public:
     void send(Packet packet);
 
     void receive(Packet packet);
-    void receive(Message message);
+    void receive(MessageHandle message);
+
+    /**
+     * A aplicação liberou espaço no buffer: se este nó recebeu uma janela
+     * zero, envia a janela atual sem esperar a próxima sonda dele.
+    */
+    void window_opened();
+
+    /**
+     * Eventos do pipeline sobre este nó, entregues pelo GroupRegistry.
+    */
+    void message_defragmentation_is_complete(const MessageDefragmentationIsComplete& event);
+    void transmission_complete(const TransmissionComplete& event);
+    void transmission_fail(const TransmissionFail& event);
 };
@@ -1,9 +1,14 @@
 #include "communication/group_registry.h"
 #include "pipeline/pipeline.h"
+#include "communication/sender_pool.h"
 
-GroupRegistry::GroupRegistry(std::string local_id) : local_id(local_id)
+GroupRegistry::GroupRegistry(
+    std::string local_id,
+    const TransmissionConfig& config,
+    PeerConfigs peer_configs
+) : local_id(local_id), peer_configs(std::move(peer_configs))
 {
-    read_nodes_from_configuration(local_id);
+    read_nodes_from_configuration(config);
 }
 
 GroupRegistry::~GroupRegistry()
@@ -12,28 +17,57 @@ GroupRegistry::~GroupRegistry()
 
 const Node &GroupRegistry::get_node(std::string id)
 {
-    std::map<std::string, Node>::iterator iterator = nodes.find(id);
-    if (iterator != nodes.end())
+    std::shared_lock lock(mutex);
+
+    auto iterator = peers_by_id.find(id);
+    if (iterator != peers_by_id.end())
     {
-        return iterator->second;
+        return *peers[iterator->second].node;
     }
     throw std::invalid_argument(format("Node %s not found.", id.c_str()));
 }
 
 const Node &GroupRegistry::get_node(SocketAddress address)
 {
-    for (auto &[id, node] : nodes)
+    std::shared_lock lock(mutex);
+
+    auto iterator = peers_by_address.find(address.pack());
+    if (iterator != peers_by_address.end())
     {
-        if (address == node.get_address())
-        {
-            return node;
-        }
+        return *peers[iterator->second].node;
     }
     throw std::invalid_argument(format("Node with address %s not found.", address.to_string().c_str()));
 }
 
-const std::map<std::string, Node> &GroupRegistry::get_nodes()
+uint32_t GroupRegistry::find_peer(const SocketAddress& address)
 {
+    std::shared_lock lock(mutex);
+
+    auto iterator = peers_by_address.find(address.pack());
+    return iterator != peers_by_address.end() ? iterator->second : UNKNOWN_PEER;
+}
+
+const Node &GroupRegistry::get_peer(uint32_t peer)
+{
+    std::shared_lock lock(mutex);
+
+    if (peer < peers.size())
+    {
+        return *peers[peer].node;
+    }
+    throw std::invalid_argument(format("Node %u not found.", peer));
+}
+
+std::vector<Node> GroupRegistry::get_nodes()
+{
+    std::shared_lock lock(mutex);
+
+    std::vector<Node> nodes;
+    for (const Peer& peer : peers)
+    {
+        if (!peer.removed)
+            nodes.push_back(*peer.node);
+    }
     return nodes;
 }
 
@@ -42,40 +76,321 @@ const Node &GroupRegistry::get_local_node()
     return get_node(local_id);
 }
 
-void GroupRegistry::read_nodes_from_configuration(std::string local_id)
+const TransmissionConfig &GroupRegistry::get_config()
+{
+    return *default_config;
+}
+
+std::shared_ptr<const TransmissionConfig> GroupRegistry::get_config(uint32_t peer)
+{
+    std::shared_lock lock(mutex);
+    return peer < peers.size() ? peers[peer].config : default_config;
+}
+
+std::shared_ptr<Connection> GroupRegistry::find_connection(uint32_t peer)
+{
+    std::shared_lock lock(mutex);
+    return peer < peers.size() ? peers[peer].connection : nullptr;
+}
+
+std::shared_ptr<Connection> GroupRegistry::get_connection(uint32_t peer)
+{
+    std::shared_ptr<Connection> connection = find_connection(peer);
+    if (connection)
+        return connection;
+
+    std::unique_lock lock(mutex);
+
+    if (peer >= peers.size() || peers[peer].removed || !pipeline)
+        return nullptr;
+
+    Peer &slot = peers[peer];
+    if (!slot.connection)
+    {
+        log_debug("Creating connection with node ", slot.node->get_id(), ".");
+        slot.connection = std::make_shared<Connection>(
+            *peers[peers_by_id.at(local_id)].node, *slot.node, *pipeline, *application_buffer, *sender_pool, slot.config, slot.descriptor
+        );
+    }
+    return slot.connection;
+}
+
+std::shared_ptr<Connection> GroupRegistry::get_connection(std::string id)
+{
+    uint32_t peer;
+    {
+        std::shared_lock lock(mutex);
+        peer = peers_by_id.at(id);
+    }
+    return get_connection(peer);
+}
+
+bool GroupRegistry::packet_originates_from_group(const Packet& packet)
+{
+    return packet.meta.peer != UNKNOWN_PEER;
+}
+
+void GroupRegistry::setup_connections(
+    Pipeline &pipeline,
+    Buffer<MessageHandle> &application_buffer,
+    SenderPool &sender_pool
+) {
+    std::unique_lock lock(mutex);
+
+    this->pipeline = &pipeline;
+    this->application_buffer = &application_buffer;
+    this->sender_pool = &sender_pool;
+
+    obs_message_defragmentation_is_complete.on([this](const MessageDefragmentationIsComplete& event) {
+        if (std::shared_ptr<Connection> connection = find_connection(event.peer()))
+            connection->message_defragmentation_is_complete(event);
+    });
+    obs_transmission_complete.on([this](const TransmissionComplete& event) {
+        if (std::shared_ptr<Connection> connection = find_connection(event.peer()))
+            connection->transmission_complete(event);
+    });
+    obs_transmission_fail.on([this](const TransmissionFail& event) {
+        if (std::shared_ptr<Connection> connection = find_connection(event.peer()))
+            connection->transmission_fail(event);
+    });
+    pipeline.attach(obs_message_defragmentation_is_complete);
+    pipeline.attach(obs_transmission_complete);
+    pipeline.attach(obs_transmission_fail);
+    application_buffer.on_space(std::bind(&GroupRegistry::reopen_windows, this));
+
+    if (default_config->connection_idle_timeout)
+        timer.add(default_config->connection_idle_timeout / 2, std::bind(&GroupRegistry::release_idle_connections, this));
+}
+
+void GroupRegistry::release_idle_connections()
+{
+    std::vector<std::shared_ptr<Connection>> released;
+    std::vector<uint32_t> idle_peers;
+    {
+        std::unique_lock lock(mutex);
+
+        for (uint32_t peer = 0; peer < peers.size(); peer++)
+        {
+            Peer &slot = peers[peer];
+
+            // Novas referências só são obtidas com o lock, então uma conexão
+            // sem outros donos agora não ganha nenhum durante a varredura.
+            if (!slot.connection || slot.connection.use_count() != 1)
+                continue;
+            if (!slot.connection->suspend(default_config->connection_idle_timeout, slot.descriptor))
+                continue;
+
+            released.push_back(std::move(slot.connection));
+            idle_peers.push_back(peer);
+        }
+    }
+
+    // O destrutor da conexão espera o SenderPool soltá-la, então ela é
+    // destruída por um worker dele, fora do lock e fora desta thread.
+    sender_pool->release(std::move(released));
+
+    for (uint32_t peer : idle_peers)
+        pipeline->notify(PeerIdle(peer));
+
+    if (idle_peers.size())
+    {
+        log_debug("Released ", idle_peers.size(), " idle connection(s).");
+    }
+
+    timer.add(default_config->connection_idle_timeout / 2, std::bind(&GroupRegistry::release_idle_connections, this));
+}
+
+void GroupRegistry::reopen_windows()
+{
+    std::shared_lock lock(mutex);
+
+    for (Peer &slot : peers)
+    {
+        if (slot.connection)
+            slot.connection->window_opened();
+    }
+}
+
+bool GroupRegistry::add_node(std::string id, SocketAddress address)
+{
+    return add_configured_node(id, address, resolve_config(id, {}));
+}
+
+bool GroupRegistry::add_configured_node(const std::string& id, const SocketAddress& address, std::shared_ptr<const TransmissionConfig> config)
+{
+    std::unique_lock lock(mutex);
+
+    if (!insert_node(id, address, config))
+    {
+        log_warn("Node ", id, " (", address.to_string(), ") is already in the group.");
+        return false;
+    }
+
+    log_info("Node ", id, " (", address.to_string(), ") joined the group.");
+    return true;
+}
+
+bool GroupRegistry::remove_node(std::string id)
+{
+    if (id == local_id)
+    {
+        log_warn("The local node cannot be removed from the group.");
+        return false;
+    }
+
+    uint32_t peer;
+    std::shared_ptr<Connection> connection;
+    {
+        std::unique_lock lock(mutex);
+
+        if (!peers_by_id.contains(id))
+            return false;
+
+        connection = erase_node(id, peer);
+    }
+
+    log_info("Node ", id, " left the group.");
+
+    if (connection)
+        connection->close();
+
+    if (pipeline)
+        pipeline->notify(PeerRemoved(peer));
+
+    return true;
+}
+
+void GroupRegistry::reload()
 {
-    nodes.clear();
     Config config = ConfigReader::parse_file("nodes.conf");
-    for (NodeConfig node_config : config.nodes)
+
+    // Resolvidos antes de qualquer mudança, para que um parâmetro inválido
+    // não deixe o grupo pela metade.
+    std::vector<std::shared_ptr<const TransmissionConfig>> configs;
+    for (const NodeConfig& node_config : config.nodes)
+        configs.push_back(resolve_config(node_config.id, node_config.settings));
+
+    std::vector<std::string> removed;
+    {
+        std::shared_lock lock(mutex);
+
+        for (auto& [id, peer] : peers_by_id)
+        {
+            auto configured = std::find_if(config.nodes.begin(), config.nodes.end(), [&](const NodeConfig& node) {
+                return node.id == id && node.address == peers[peer].node->get_address();
+            });
+            bool same_config = configured != config.nodes.end()
+                && *configs[configured - config.nodes.begin()] == *peers[peer].config;
+
+            if (!same_config && id != local_id)
+                removed.push_back(id);
+        }
+    }
+
+    for (const std::string& id : removed)
+        remove_node(id);
+
+    for (std::size_t i = 0; i < config.nodes.size(); i++)
     {
-        bool is_remote = local_id != node_config.id;
-        Node node(node_config.id, node_config.address, is_remote);
-        nodes.emplace(node.get_id(), node);
+        const NodeConfig& node_config = config.nodes[i];
+
+        std::shared_lock lock(mutex);
+        bool known = peers_by_id.contains(node_config.id);
+        lock.unlock();
+
+        if (!known)
+            add_configured_node(node_config.id, node_config.address, configs[i]);
     }
 }
 
-bool GroupRegistry::packet_originates_from_group(Packet packet)
+/**
+ * Parâmetros do nó `id`: os de `peer_configs` com o bloco `options` por cima,
+ * ou os da instância, que já o têm, e então as configurações do nó no
+ * nodes.conf. Nós sem parâmetros próprios recebem os da instância,
+ * compartilhados.
+*/
+std::shared_ptr<const TransmissionConfig> GroupRegistry::resolve_config(const std::string& id, const Settings& settings)
 {
-    for (auto &[id, node] : nodes)
+    auto custom = peer_configs.find(id);
+    if (custom == peer_configs.end() && !settings.size())
+        return default_config;
+
+    TransmissionConfig config = *default_config;
+    if (custom != peer_configs.end())
     {
-        if (packet.meta.origin == node.get_address())
+        config = custom->second;
+        for (const auto& [key, value] : options)
         {
-            return true;
+            if (!TransmissionConfig::is_instance_setting(key))
+                config.set(key, value);
         }
     }
-    return false;
+
+    for (const auto& [key, value] : settings)
+    {
+        if (TransmissionConfig::is_instance_setting(key))
+            throw std::invalid_argument(format("%s cannot be set for a single node (node %s).", key.c_str(), id.c_str()));
+        config.set(key, value);
+    }
+    config.validate();
+
+    return std::make_shared<const TransmissionConfig>(config);
 }
 
-void GroupRegistry::establish_connections(
-    Pipeline &pipeline,
-    Buffer<Message> &application_buffer,
-    BufferSet<std::string> &connection_update_buffer
-) {
-    Node local_node = get_local_node();
-    for (auto &[id, node] : nodes)
-        connections.emplace(
-            std::piecewise_construct,
-            std::forward_as_tuple(id),
-            std::forward_as_tuple(local_node, node, pipeline, application_buffer, connection_update_buffer)
-        );
-}
\ No newline at end of file
+/**
+ * Chamado com o lock exclusivo.
+*/
+bool GroupRegistry::insert_node(const std::string& id, const SocketAddress& address, std::shared_ptr<const TransmissionConfig> config)
+{
+    if (peers_by_id.contains(id) || peers_by_address.contains(address.pack()))
+        return false;
+
+    uint32_t index = peers.size();
+    bool is_remote = local_id != id;
+
+    peers.push_back(Peer{
+        node : std::make_unique<Node>(index, id, address, is_remote),
+        connection : nullptr,
+        descriptor : ConnectionDescriptor{},
+        config : config,
+        removed : false
+    });
+    peers_by_id.emplace(id, index);
+    peers_by_address.emplace(address.pack(), index);
+    return true;
+}
+
+/**
+ * Chamado com o lock exclusivo. Devolve a conexão do nó, que deve ser
+ * encerrada fora do lock.
+*/
+std::shared_ptr<Connection> GroupRegistry::erase_node(const std::string& id, uint32_t& peer)
+{
+    peer = peers_by_id.at(id);
+    Peer &slot = peers[peer];
+
+    peers_by_id.erase(id);
+    peers_by_address.erase(slot.node->get_address().pack());
+    slot.removed = true;
+
+    return std::move(slot.connection);
+}
+
+void GroupRegistry::read_nodes_from_configuration(TransmissionConfig transmission_config)
+{
+    Config config = ConfigReader::parse_file("nodes.conf");
+
+    options = config.options;
+    transmission_config.apply(options);
+    transmission_config.validate();
+    default_config = std::make_shared<const TransmissionConfig>(transmission_config);
+
+    std::unique_lock lock(mutex);
+
+    peers.clear();
+    peers_by_id.clear();
+    peers_by_address.clear();
+
+    for (const NodeConfig& node_config : config.nodes)
+        insert_node(node_config.id, node_config.address, resolve_config(node_config.id, node_config.settings));
+}
@@ -1,57 +1,186 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "communication/connection.h"
 #include "core/node.h"
 #include "core/message.h"
 #include "core/packet.h"
 #include "core/buffer.h"
+#include "pipeline/transmission/transmission_config.h"
 
 class Pipeline;
+class SenderPool;
 
+/**
+ * Nós do grupo e as conexões com eles. O grupo pode mudar com o processo
+ * em execução (add_node, remove_node, reload); as conexões são criadas no
+ * primeiro contato com o nó e encerradas quando ele sai do grupo, sem
+ * afetar as demais.
+ *
+ * Conexões ociosas por connection_idle_timeout são desfeitas e voltam a um
+ * ConnectionDescriptor, de modo que a memória do processo acompanha o
+ * número de nós com quem ele conversa, e não o tamanho do grupo.
+ *
+ * O registro também resolve os parâmetros do protocolo de cada nó: os da
+ * instância (`config`), trocados pelos de `peer_configs` para os nós
+ * listados ali; por cima, o bloco `options` do nodes.conf e por fim as
+ * configurações do próprio nó no nodes.conf.
+*/
 class GroupRegistry
 {
 public:
-    GroupRegistry(std::string local_id);
+    GroupRegistry(
+        std::string local_id,
+        const TransmissionConfig& config = TransmissionConfig(),
+        PeerConfigs peer_configs = {}
+    );
     ~GroupRegistry();
 
+    /**
+     * Parâmetros da instância, já com o bloco `options` do nodes.conf.
+    */
+    const TransmissionConfig &get_config();
+
+    /**
+     * Parâmetros da conexão com o nó. Nós sem parâmetros próprios
+     * compartilham os da instância.
+    */
+    std::shared_ptr<const TransmissionConfig> get_config(uint32_t peer);
+
     const Node &get_node(std::string id);
     const Node &get_node(SocketAddress address);
-    const std::map<std::string, Node> &get_nodes();
+
+    /**
+     * Cópia dos nós que fazem parte do grupo agora.
+    */
+    std::vector<Node> get_nodes();
     const Node &get_local_node();
 
-    bool has_connection(std::string id) {
-        return connections.contains(id);
-    }
-
-    Connection& get_connection(SocketAddress address)
-    {
-        return get_connection(get_node(address));
-    }
-    Connection& get_connection(const Node& node)
-    {
-        return get_connection(node.get_id());
-    }
-    Connection& get_connection(std::string id)
-    {
-        return connections.at(id);
-    }
-
-    bool packet_originates_from_group(Packet packet);
-
-    void establish_connections(
+    /**
+     * Índice do nó com o endereço dado, ou UNKNOWN_PEER se nenhum nó do
+     * grupo usa esse endereço.
+    */
+    uint32_t find_peer(const SocketAddress& address);
+
+    /**
+     * Nó pelo índice. Nós removidos continuam acessíveis, para identificar o
+     * remetente de mensagens recebidas antes da remoção.
+    */
+    const Node &get_peer(uint32_t peer);
+
+    /**
+     * Conexão com o nó, criada no primeiro contato. Nós removidos não têm
+     * conexão, e o retorno é nullptr; ids desconhecidos lançam
+     * std::out_of_range.
+    */
+    std::shared_ptr<Connection> get_connection(uint32_t peer);
+    std::shared_ptr<Connection> get_connection(std::string id);
+
+    /**
+     * Conexão já criada com o nó, sem criar uma nova.
+    */
+    std::shared_ptr<Connection> find_connection(uint32_t peer);
+
+    bool packet_originates_from_group(const Packet& packet);
+
+    /**
+     * Guarda o que é preciso para criar conexões, passa a entregar a elas
+     * os eventos do pipeline sobre o seu nó e começa a desfazer as ociosas.
+    */
+    void setup_connections(
         Pipeline& pipeline,
-        Buffer<Message> &application_buffer,
-        BufferSet<std::string> &connection_update_buffer
+        Buffer<MessageHandle> &application_buffer,
+        SenderPool &sender_pool
     );
 
+    /**
+     * Inclui um nó no grupo. Retorna false se o id ou o endereço já estão
+     * em uso.
+    */
+    bool add_node(std::string id, SocketAddress address);
+
+    /**
+     * Retira um nó do grupo: as transmissões pendentes para ele falham e o
+     * estado do pipeline para ele é descartado. O nó local não pode ser
+     * removido.
+    */
+    bool remove_node(std::string id);
+
+    /**
+     * Lê nodes.conf de novo e aplica a diferença: nós novos são incluídos,
+     * nós ausentes são removidos e nós com outro endereço ou outros
+     * parâmetros são trocados. O bloco `options` só é lido na criação.
+    */
+    void reload();
+
 private:
     std::string local_id;
 
-    std::map<std::string, Node> nodes;
-    std::map<std::string, Connection> connections;
+    /**
+     * Estado por nó, indexado pelo índice do nó. Índices não são
+     * reaproveitados: um nó removido fica marcado, e incluí-lo de novo cria
+     * outro índice.
+    */
+    struct Peer {
+        std::unique_ptr<Node> node;
+        std::shared_ptr<Connection> connection;
+        /**
+         * Estado da última conexão desfeita por ociosidade, usado para
+         * criar a próxima.
+        */
+        ConnectionDescriptor descriptor;
+        std::shared_ptr<const TransmissionConfig> config;
+        bool removed = false;
+    };
+
+    std::vector<Peer> peers;
+    std::unordered_map<std::string, uint32_t> peers_by_id;
+    std::unordered_map<uint64_t, uint32_t> peers_by_address;
+    std::shared_mutex mutex;
+
+    std::shared_ptr<const TransmissionConfig> default_config;
+    PeerConfigs peer_configs;
+    /**
+     * Bloco `options` do nodes.conf lido na criação, aplicado também sobre
+     * os `peer_configs`.
+    */
+    Settings options;
+
+    Pipeline *pipeline = nullptr;
+    Buffer<MessageHandle> *application_buffer = nullptr;
+    SenderPool *sender_pool = nullptr;
+
+    Observer<MessageDefragmentationIsComplete> obs_message_defragmentation_is_complete;
+    Observer<TransmissionComplete> obs_transmission_complete;
+    Observer<TransmissionFail> obs_transmission_fail;
+
+    std::shared_ptr<const TransmissionConfig> resolve_config(const std::string& id, const Settings& settings);
+
+    bool insert_node(const std::string& id, const SocketAddress& address, std::shared_ptr<const TransmissionConfig> config);
+    bool add_configured_node(const std::string& id, const SocketAddress& address, std::shared_ptr<const TransmissionConfig> config);
+    std::shared_ptr<Connection> erase_node(const std::string& id, uint32_t& peer);
+
+    void read_nodes_from_configuration(TransmissionConfig config);
+
+    /**
+     * Desfaz as conexões ociosas e agenda a próxima varredura.
+    */
+    void release_idle_connections();
+
+    /**
+     * Chamado pelo buffer da aplicação quando ela consome depois de uma
+     * janela zero: as conexões que a anunciaram enviam a janela nova.
+    */
+    void reopen_windows();
 
-    void read_nodes_from_configuration(std::string local_id);
+    /**
+     * Último membro, para ser destruído primeiro: cancela a varredura
+     * antes que o resto do registro deixe de existir.
+    */
+    Timer timer;
 };
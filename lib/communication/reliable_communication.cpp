@@ -1,6 +1,7 @@
 #include "communication/reliable_communication.h"
 
 #include "pipeline/fault_injection/fault_injection_layer.h"
+#include "pipeline/protocol_stack.h"
 
 ReliableCommunication::ReliableCommunication(
     std::string _local_id,
@@ -11,32 +12,64 @@ ReliableCommunication::ReliableCommunication(
     std::string _local_id,
     std::size_t _user_buffer_size,
     FaultConfig fault_config
+) : ReliableCommunication(_local_id, _user_buffer_size, fault_config, TransmissionConfig()) {}
+
+ReliableCommunication::ReliableCommunication(
+    std::string _local_id,
+    std::size_t _user_buffer_size,
+    FaultConfig fault_config,
+    TransmissionConfig transmission_config,
+    PeerConfigs peer_configs
 ) :
-    connection_update_buffer("connection_update"),
+    gr(new GroupRegistry(_local_id, transmission_config, std::move(peer_configs))),
+    sender_pool(gr->get_config().sender_workers),
     user_buffer_size(_user_buffer_size),
-    application_buffer(INTERMEDIARY_BUFFER_ITEMS)
+    application_buffer("application receive", gr->get_config().receive_buffer_items)
 {
-    gr = new GroupRegistry(_local_id);
-    pipeline = new Pipeline(gr, fault_config);
+    if (gr->get_config().static_pipeline)
+        pipeline = new StaticProtocolPipeline(gr, fault_config, gr->get_config());
+    else
+        pipeline = new Pipeline(gr, fault_config, gr->get_config());
 
-    sender_thread = std::thread([this]()
-                                { send_routine(); });
+    gr->setup_connections(*pipeline, application_buffer, sender_pool);
 
-    gr->establish_connections(*pipeline, application_buffer, connection_update_buffer);
+    obs_message_delivered.on(std::bind(&ReliableCommunication::message_delivered, this, _1));
+    pipeline->attach(obs_message_delivered);
 }
 
 ReliableCommunication::~ReliableCommunication()
 {
-    connection_update_buffer.terminate();
-    if (sender_thread.joinable())
-        sender_thread.join();
+    sender_pool.stop();
 
     delete gr;
     delete pipeline;
+
+    mutex_async_transmissions.lock();
+    std::unordered_map<Transmission*, std::unique_ptr<Transmission>> pending = std::move(async_transmissions);
+    async_transmissions.clear();
+    mutex_async_transmissions.unlock();
+
+    for (auto& [ptr, transmission] : pending)
+    {
+        transmission->set_result(false);
+        transmission->release();
+    }
 }
 
 void ReliableCommunication::shutdown() {
     application_buffer.terminate();
+
+    mutex_receive_waiters.lock();
+    receive_terminated = true;
+    std::deque<ReceiveAwaiter*> waiters = std::move(receive_waiters);
+    receive_waiters.clear();
+    mutex_receive_waiters.unlock();
+
+    for (ReceiveAwaiter* awaiter : waiters)
+    {
+        awaiter->terminated = true;
+        EventLoop::resume_on(awaiter->loop, awaiter->handle);
+    }
 }
 
 GroupRegistry *ReliableCommunication::get_group_registry()
@@ -44,10 +77,136 @@ GroupRegistry *ReliableCommunication::get_group_registry()
     return gr;
 }
 
+bool ReliableCommunication::add_node(std::string id, SocketAddress address)
+{
+    return gr->add_node(id, address);
+}
+
+bool ReliableCommunication::remove_node(std::string id)
+{
+    return gr->remove_node(id);
+}
+
+void ReliableCommunication::reload_nodes()
+{
+    gr->reload();
+}
+
+std::map<std::string, RttStats> ReliableCommunication::get_rtt_stats()
+{
+    return pipeline->get_rtt_stats();
+}
+
+std::map<std::string, CongestionStats> ReliableCommunication::get_congestion_stats()
+{
+    return pipeline->get_congestion_stats();
+}
+
+CommunicationStats ReliableCommunication::stats()
+{
+    CommunicationStats result;
+
+    // Um nó removido e adicionado de novo, ou recriado por reload(), ganha
+    // outro índice; os contadores dos índices de um mesmo id são somados.
+    for (auto& [peer, values] : pipeline->get_counters().snapshot())
+    {
+        PeerStats& stats = result.peers[gr->get_peer(peer).get_id()];
+        stats.packets_sent += values[(std::size_t) Counter::PACKETS_SENT];
+        stats.bytes_sent += values[(std::size_t) Counter::BYTES_SENT];
+        stats.packets_received += values[(std::size_t) Counter::PACKETS_RECEIVED];
+        stats.bytes_received += values[(std::size_t) Counter::BYTES_RECEIVED];
+        stats.retransmissions += values[(std::size_t) Counter::RETRANSMISSIONS];
+        stats.timeouts += values[(std::size_t) Counter::TIMEOUTS];
+        stats.duplicate_fragments += values[(std::size_t) Counter::DUPLICATE_FRAGMENTS];
+        stats.checksum_failures += values[(std::size_t) Counter::CHECKSUM_FAILURES];
+        stats.reorder_drops += values[(std::size_t) Counter::REORDER_DROPS];
+        stats.buffer_full_drops += values[(std::size_t) Counter::BUFFER_FULL_DROPS];
+
+        // Só o índice atual do nó tem conexão.
+        if (std::shared_ptr<Connection> connection = gr->find_connection(peer))
+            stats.queued_messages = connection->get_queued_transmissions();
+    }
+
+    for (auto& [id, congestion] : pipeline->get_congestion_stats())
+    {
+        auto peer = result.peers.find(id);
+        if (peer == result.peers.end())
+            continue;
+
+        peer->second.queued_fragments = congestion.queued;
+        peer->second.fragments_in_flight = congestion.in_flight;
+    }
+    for (auto& [id, rtt] : pipeline->get_rtt_stats())
+    {
+        auto peer = result.peers.find(id);
+        if (peer != result.peers.end())
+            peer->second.rtt = rtt;
+    }
+
+    result.layers = pipeline->get_layer_stats();
+    return result;
+}
+
 ReceiveResult ReliableCommunication::receive(char *m)
 {
-    Message message = application_buffer.consume();
+    MessageHandle message = application_buffer.consume();
+    return deliver(*message, m);
+}
+
+ReceivedMessage ReliableCommunication::receive()
+{
+    return lend(application_buffer.consume());
+}
+
+std::optional<ReceivedMessage> ReliableCommunication::try_receive()
+{
+    std::optional<MessageHandle> message = application_buffer.try_consume();
+    if (!message) return std::nullopt;
 
+    return lend(std::move(*message));
+}
+
+std::optional<ReceivedMessage> ReliableCommunication::receive_for(std::chrono::milliseconds timeout)
+{
+    std::optional<MessageHandle> message = application_buffer.consume_for(timeout);
+    if (!message) return std::nullopt;
+
+    return lend(std::move(*message));
+}
+
+std::size_t ReliableCommunication::receive_many(std::span<ReceivedMessage> messages, std::chrono::milliseconds timeout)
+{
+    if (messages.empty()) return 0;
+
+    auto lend_handle = [this](MessageHandle&& handle) { return lend(std::move(handle)); };
+    std::size_t count = application_buffer.try_consume_many(messages, lend_handle);
+
+    if (!count)
+    {
+        std::optional<MessageHandle> first = application_buffer.consume_for(timeout);
+        if (!first) return 0;
+
+        messages[0] = lend(std::move(*first));
+        count = 1 + application_buffer.try_consume_many(messages.subspan(1), lend_handle);
+    }
+
+    return count;
+}
+
+ReceivedMessage ReliableCommunication::lend(MessageHandle message)
+{
+    SocketAddress origin = message->origin;
+    const Node& node = gr->get_peer(message->peer);
+
+    return ReceivedMessage{
+        message : std::move(message),
+        sender_address : origin,
+        sender_id : node.get_id()
+    };
+}
+
+ReceiveResult ReliableCommunication::deliver(const Message& message, char *m)
+{
     std::size_t len = std::min(message.length, user_buffer_size);
     memcpy(m, message.data, len);
 
@@ -56,7 +215,7 @@ ReceiveResult ReliableCommunication::receive(char *m)
         log_warn("User's buffer is smaller than the message; truncating it.");
     }
 
-    Node node = gr->get_node(message.origin);
+    const Node& node = gr->get_peer(message.peer);
     return ReceiveResult{
         length : len,
         truncated_bytes : message.length - len,
@@ -65,7 +224,7 @@ ReceiveResult ReliableCommunication::receive(char *m)
     };
 }
 
-bool ReliableCommunication::send(std::string id, MessageData data)
+bool ReliableCommunication::validate_size(MessageData& data)
 {
     if (data.size == std::size_t(-1))
         data.size = user_buffer_size;
@@ -79,6 +238,14 @@ bool ReliableCommunication::send(std::string id, MessageData data)
         return false;
     }
 
+    return true;
+}
+
+bool ReliableCommunication::send(std::string id, MessageData data)
+{
+    if (!validate_size(data))
+        return false;
+
     Transmission transmission = create_transmission(id, data);
     bool enqueued = enqueue(transmission);
 
@@ -96,16 +263,259 @@ bool ReliableCommunication::send(std::string id, MessageData data)
     return result.success;
 }
 
+bool ReliableCommunication::SendAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    EventLoop* loop = EventLoop::current();
+
+    return comm.send_async(id, data, [this, loop, handle](bool result) {
+        success = result;
+        EventLoop::resume_on(loop, handle);
+    });
+}
+
+bool ReliableCommunication::ReceiveAwaiter::await_ready()
+{
+    message = comm.application_buffer.try_consume();
+    return message.has_value();
+}
+
+bool ReliableCommunication::ReceiveAwaiter::await_suspend(std::coroutine_handle<> awaiting)
+{
+    handle = awaiting;
+    loop = EventLoop::current();
+    return comm.wait_message(this);
+}
+
+ReceiveResult ReliableCommunication::ReceiveAwaiter::await_resume()
+{
+    if (terminated) throw buffer_termination("Exiting buffer.");
+    return comm.deliver(**message, m);
+}
+
+bool ReliableCommunication::wait_message(ReceiveAwaiter* awaiter)
+{
+    std::lock_guard lock(mutex_receive_waiters);
+
+    if (receive_terminated)
+    {
+        awaiter->terminated = true;
+        return false;
+    }
+
+    // Refeito com o lock para não perder uma entrega que ocorreu depois de
+    // await_ready().
+    awaiter->message = application_buffer.try_consume();
+    if (awaiter->message) return false;
+
+    receive_waiters.push_back(awaiter);
+    return true;
+}
+
+void ReliableCommunication::message_delivered(const MessageDelivered&)
+{
+    std::vector<ReceiveAwaiter*> ready;
+
+    mutex_receive_waiters.lock();
+    while (!receive_waiters.empty())
+    {
+        std::optional<MessageHandle> message = application_buffer.try_consume();
+        if (!message) break;
+
+        ReceiveAwaiter* awaiter = receive_waiters.front();
+        receive_waiters.pop_front();
+        awaiter->message = std::move(message);
+        ready.push_back(awaiter);
+    }
+    mutex_receive_waiters.unlock();
+
+    for (ReceiveAwaiter* awaiter : ready)
+        EventLoop::resume_on(awaiter->loop, awaiter->handle);
+}
+
+std::future<bool> ReliableCommunication::send_async(std::string id, MessageData data)
+{
+    std::shared_ptr<std::promise<bool>> promise = std::make_shared<std::promise<bool>>();
+    std::future<bool> future = promise->get_future();
+
+    bool enqueued = send_async(id, data, [promise](bool success) {
+        promise->set_value(success);
+    });
+
+    if (!enqueued)
+        promise->set_value(false);
+
+    return future;
+}
+
+bool ReliableCommunication::send_async(std::string id, MessageData data, std::function<void(bool)> callback)
+{
+    if (!validate_size(data))
+        return false;
+
+    std::unique_ptr<Transmission> owned = std::make_unique<Transmission>(id, create_message(id, data));
+    Transmission* transmission = owned.get();
+
+    transmission->on_complete = [this, transmission, callback](const TransmissionResult& result) {
+        std::unique_ptr<Transmission> finished = release_async(transmission);
+        log_debug("Transmission ", transmission->uuid, " returned result to application.");
+
+        if (callback) callback(result.success);
+    };
+
+    mutex_async_transmissions.lock();
+    async_transmissions.emplace(transmission, std::move(owned));
+    mutex_async_transmissions.unlock();
+
+    if (!enqueue(*transmission)) {
+        log_warn(
+            "Could not enqueue transmission ", transmission->uuid,
+            ", node connection must be overloaded."
+        );
+        transmission->on_complete = nullptr;
+        release_async(transmission);
+        return false;
+    }
+
+    return true;
+}
+
+std::future<std::vector<bool>> ReliableCommunication::send_many(const std::vector<OutgoingMessage>& messages)
+{
+    std::shared_ptr<std::promise<std::vector<bool>>> promise = std::make_shared<std::promise<std::vector<bool>>>();
+    std::future<std::vector<bool>> future = promise->get_future();
+
+    send_many(messages, [promise](std::vector<bool> results) {
+        promise->set_value(std::move(results));
+    });
+
+    return future;
+}
+
+void ReliableCommunication::send_many(
+    const std::vector<OutgoingMessage>& messages,
+    std::function<void(std::vector<bool>)> callback
+)
+{
+    struct Batch {
+        std::vector<uint8_t> results;
+        std::atomic<std::size_t> remaining;
+        std::function<void(std::vector<bool>)> callback;
+    };
+
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->results.assign(messages.size(), false);
+    batch->callback = callback;
+    // A unidade extra impede que o lote termine antes de tudo ser enfileirado.
+    batch->remaining = messages.size() + 1;
+
+    auto finish_one = [batch]() {
+        if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        std::vector<bool> results(batch->results.begin(), batch->results.end());
+        if (batch->callback) batch->callback(std::move(results));
+    };
+
+    std::vector<std::unique_ptr<Transmission>> owned;
+    std::unordered_map<std::string, std::vector<Transmission*>> by_destination;
+
+    for (std::size_t i = 0; i < messages.size(); i++)
+    {
+        const std::string& id = messages[i].first;
+        MessageData data = messages[i].second;
+
+        if (!validate_size(data))
+        {
+            finish_one();
+            continue;
+        }
+
+        // Um destino desconhecido (ou já removido) falha só a própria
+        // mensagem, sem impedir o envio do resto do lote.
+        Message message;
+        try
+        {
+            message = create_message(id, data);
+        }
+        catch (const std::invalid_argument& error)
+        {
+            log_warn("Could not send message ", i, " of the batch to node ", id, ": ", error.what());
+            finish_one();
+            continue;
+        }
+
+        owned.push_back(std::make_unique<Transmission>(id, message));
+        Transmission* transmission = owned.back().get();
+
+        transmission->on_complete = [this, transmission, batch, i, finish_one](const TransmissionResult& result) {
+            std::unique_ptr<Transmission> finished = release_async(transmission);
+            batch->results[i] = result.success;
+            finish_one();
+        };
+
+        by_destination[id].push_back(transmission);
+    }
+
+    mutex_async_transmissions.lock();
+    for (std::unique_ptr<Transmission>& transmission : owned)
+    {
+        Transmission* key = transmission.get();
+        async_transmissions.emplace(key, std::move(transmission));
+    }
+    mutex_async_transmissions.unlock();
+
+    for (auto& [id, transmissions] : by_destination)
+    {
+        std::shared_ptr<Connection> connection = gr->get_connection(id);
+        std::size_t enqueued = connection ? connection->enqueue_many(transmissions) : 0;
+
+        if (enqueued < transmissions.size())
+        {
+            log_warn(
+                "Could not enqueue ", transmissions.size() - enqueued, " transmission(s) to node ", id,
+                ", node connection must be overloaded."
+            );
+        }
+
+        for (std::size_t i = enqueued; i < transmissions.size(); i++)
+        {
+            transmissions[i]->set_result(false);
+            transmissions[i]->release();
+        }
+    }
+
+    finish_one();
+}
+
+std::unique_ptr<Transmission> ReliableCommunication::release_async(Transmission* transmission)
+{
+    std::unique_ptr<Transmission> owned;
+
+    mutex_async_transmissions.lock();
+    auto it = async_transmissions.find(transmission);
+    if (it != async_transmissions.end())
+    {
+        owned = std::move(it->second);
+        async_transmissions.erase(it);
+    }
+    mutex_async_transmissions.unlock();
+
+    return owned;
+}
+
 Message ReliableCommunication::create_message(std::string receiver_id, const MessageData &data)
 {
+    const Node& receiver = gr->get_node(receiver_id);
+
     Message m = {
         transmission_uuid : UUID(""),
         number : 0,
         origin : gr->get_local_node().get_address(),
-        destination : gr->get_node(receiver_id).get_address(),
+        destination : receiver.get_address(),
         type : MessageType::APPLICATION,
         data : {0},
         length : data.size,
+        peer : receiver.get_index(),
     };
     memcpy(m.data, data.ptr, data.size);
     return m;
@@ -120,25 +530,6 @@ Transmission ReliableCommunication::create_transmission(std::string receiver_id,
 
 bool ReliableCommunication::enqueue(Transmission &transmission)
 {
-    Connection &connection = gr->get_connection(transmission.receiver_id);
-    return connection.enqueue(transmission);
+    std::shared_ptr<Connection> connection = gr->get_connection(transmission.receiver_id);
+    return connection && connection->enqueue(transmission);
 }
-
-void ReliableCommunication::send_routine()
-{
-    std::string id;
-    while (true)
-    {
-        try
-        {
-            id = connection_update_buffer.consume();
-        }
-        catch (const std::runtime_error &e)
-        {
-            return;
-        }
-
-        Connection &connection = gr->get_connection(id);
-        connection.update();
-    }
-}
\ No newline at end of file
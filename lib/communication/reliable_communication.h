@@ -4,14 +4,26 @@
 #include <map>
 #include <memory>
 #include <semaphore>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <deque>
+#include <optional>
+#include <coroutine>
+#include <chrono>
+#include <span>
 
 #include "communication/connection.h"
 #include "core/buffer.h"
 #include "core/constants.h"
 #include "core/message.h"
+#include "core/message_pool.h"
 #include "core/packet.h"
 #include "core/node.h"
 #include "communication/group_registry.h"
+#include "communication/sender_pool.h"
+#include "core/event_loop.h"
 #include "pipeline/pipeline.h"
 #include "utils/format.h"
 #include "communication/transmission.h"
@@ -28,6 +40,11 @@ struct MessageData
     MessageData(const char *ptr, std::size_t size) : ptr(ptr), size(size) {}
 };
 
+/**
+ * Destino e conteúdo de uma mensagem de send_many().
+*/
+using OutgoingMessage = std::pair<std::string, MessageData>;
+
 struct ReceiveResult {
     size_t length;
     size_t truncated_bytes;
@@ -35,6 +52,61 @@ struct ReceiveResult {
     std::string sender_id;
 };
 
+/**
+ * Mensagem recebida emprestada da biblioteca: os dados ficam no bloco onde
+ * os fragmentos foram remontados, que volta ao pool quando o objeto é
+ * destruído.
+*/
+struct ReceivedMessage {
+    MessageHandle message;
+    SocketAddress sender_address;
+    std::string sender_id;
+
+    const char* data() const { return message->data; }
+    std::size_t length() const { return message->length; }
+};
+
+/**
+ * Contadores e filas da comunicação com um nó. Os contadores são totais
+ * desde a criação da instância; as filas e o RTT são os de agora.
+*/
+struct PeerStats {
+    uint64_t packets_sent = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t packets_received = 0;
+    uint64_t bytes_received = 0;
+    uint64_t retransmissions = 0;
+    uint64_t timeouts = 0;
+    uint64_t duplicate_fragments = 0;
+    uint64_t checksum_failures = 0;
+    uint64_t reorder_drops = 0;
+    uint64_t buffer_full_drops = 0;
+
+    /**
+     * Mensagens aguardando envio na conexão.
+    */
+    uint32_t queued_messages = 0;
+    /**
+     * Fragmentos aguardando espaço na janela de congestionamento.
+    */
+    uint32_t queued_fragments = 0;
+    uint32_t fragments_in_flight = 0;
+
+    RttStats rtt = {};
+};
+
+struct CommunicationStats {
+    /**
+     * Nós com algum tráfego, pelo id.
+    */
+    std::map<std::string, PeerStats> peers;
+    /**
+     * Tempo gasto em cada camada do pipeline, da mais baixa para a mais
+     * alta, e na entrega às conexões.
+    */
+    std::vector<LayerStats> layers;
+};
+
 class ReliableCommunication
 {
 public:
@@ -44,29 +116,184 @@ public:
         std::size_t _user_buffer_size,
         FaultConfig fault_config
     );
+    /**
+     * `transmission_config` vale para todos os nós, exceto os listados em
+     * `peer_configs`. O bloco `options` e as configurações por nó do
+     * nodes.conf são aplicados por cima (ver GroupRegistry).
+    */
+    ReliableCommunication(
+        std::string _local_id,
+        std::size_t _user_buffer_size,
+        FaultConfig fault_config,
+        TransmissionConfig transmission_config,
+        PeerConfigs peer_configs = {}
+    );
     ~ReliableCommunication();
 
     void shutdown();
 
     bool send(std::string id, MessageData data);
+
+    /**
+     * Envia sem bloquear. O futuro resolve para o mesmo valor que send()
+     * retornaria, e os dados são copiados antes do retorno.
+    */
+    std::future<bool> send_async(std::string id, MessageData data);
+
+    /**
+     * Envia sem bloquear e chama `callback` com o resultado quando a
+     * transmissão terminar. O callback executa em uma thread da biblioteca e
+     * não deve bloquear. Retorna false, sem chamar o callback, se a mensagem
+     * não pôde ser enfileirada.
+    */
+    bool send_async(std::string id, MessageData data, std::function<void(bool)> callback);
+
+    /**
+     * Envia várias mensagens de uma vez. Elas são agrupadas por destino, e
+     * cada conexão recebe as suas com uma única aquisição do lock e um único
+     * pedido ao SenderPool. O futuro resolve quando todas terminarem, com o
+     * resultado de cada mensagem na ordem de `messages`.
+    */
+    std::future<std::vector<bool>> send_many(const std::vector<OutgoingMessage>& messages);
+
+    /**
+     * Como send_many(), mas chama `callback` uma única vez, em uma thread da
+     * biblioteca, quando todas as mensagens terminarem.
+    */
+    void send_many(const std::vector<OutgoingMessage>& messages, std::function<void(std::vector<bool>)> callback);
     ReceiveResult receive(char *m);
 
+    /**
+     * Recebe sem copiar a mensagem para um buffer do usuário.
+    */
+    ReceivedMessage receive();
+
+    /**
+     * Retorna a próxima mensagem já disponível, sem bloquear.
+    */
+    std::optional<ReceivedMessage> try_receive();
+
+    /**
+     * Espera no máximo `timeout` por uma mensagem.
+    */
+    std::optional<ReceivedMessage> receive_for(std::chrono::milliseconds timeout);
+
+    /**
+     * Espera no máximo `timeout` pela primeira mensagem e então retira, sem
+     * bloquear, todas as que já estiverem disponíveis, até `messages.size()`.
+     * Retorna quantas mensagens foram escritas em `messages` (0 se o prazo
+     * venceu).
+    */
+    std::size_t receive_many(std::span<ReceivedMessage> messages, std::chrono::milliseconds timeout);
+
+    struct SendAwaiter {
+        ReliableCommunication& comm;
+        std::string id;
+        MessageData data;
+        bool success = false;
+
+        SendAwaiter(ReliableCommunication& comm, std::string id, MessageData data)
+            : comm(comm), id(id), data(data) {}
+
+        bool await_ready() { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        bool await_resume() { return success; }
+    };
+
+    struct ReceiveAwaiter {
+        ReliableCommunication& comm;
+        char* m;
+        std::optional<MessageHandle> message;
+        bool terminated = false;
+        EventLoop* loop = nullptr;
+        std::coroutine_handle<> handle;
+
+        ReceiveAwaiter(ReliableCommunication& comm, char *m) : comm(comm), m(m) {}
+
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> handle);
+        ReceiveResult await_resume();
+    };
+
+    /**
+     * Versões de send() e receive() para corrotinas: `co_await
+     * comm.co_send(id, data)` suspende a corrotina, sem bloquear a thread,
+     * até o envio terminar. Chamadas de dentro de um EventLoop, a corrotina
+     * é retomada nas threads dele.
+    */
+    SendAwaiter co_send(std::string id, MessageData data) { return SendAwaiter(*this, id, data); }
+    ReceiveAwaiter co_receive(char *m) { return ReceiveAwaiter(*this, m); }
+
     GroupRegistry *get_group_registry();
 
+    /**
+     * Inclui ou retira nós do grupo sem reiniciar o processo. As conexões
+     * com os demais nós seguem intactas; a conexão com um nó incluído só é
+     * criada no primeiro contato com ele.
+    */
+    bool add_node(std::string id, SocketAddress address);
+    bool remove_node(std::string id);
+
+    /**
+     * Relê nodes.conf e aplica os nós incluídos e retirados.
+    */
+    void reload_nodes();
+
+    /**
+     * Estimativas de RTT e timeout de retransmissão atuais de cada nó com o
+     * qual esta instância já trocou mensagens, indexadas pelo id do nó.
+    */
+    std::map<std::string, RttStats> get_rtt_stats();
+
+    /**
+     * Janela de congestionamento e contadores de envio de cada nó.
+    */
+    std::map<std::string, CongestionStats> get_congestion_stats();
+
+    /**
+     * Snapshot dos contadores de cada nó e do tempo de cada camada. Os
+     * contadores são escritos sem lock por cada thread e somados aqui, então
+     * chamar stats() não atrasa o caminho dos pacotes.
+    */
+    CommunicationStats stats();
+
 private:
     Pipeline *pipeline;
     GroupRegistry *gr;
 
-    std::thread sender_thread;
-    BufferSet<std::string> connection_update_buffer;
+    SenderPool sender_pool;
 
     std::size_t user_buffer_size;
-    Buffer<Message> application_buffer{"application receive"};
+    Buffer<MessageHandle> application_buffer;
+
+    /**
+     * Transmissões de send_async ainda em andamento, que pertencem à
+     * biblioteca até terminarem.
+    */
+    std::unordered_map<Transmission*, std::unique_ptr<Transmission>> async_transmissions;
+    std::mutex mutex_async_transmissions;
+
+    /**
+     * Corrotinas aguardando mensagens em co_receive, atendidas em ordem de
+     * chegada.
+    */
+    std::deque<ReceiveAwaiter*> receive_waiters;
+    std::mutex mutex_receive_waiters;
+    bool receive_terminated = false;
+
+    Observer<MessageDelivered> obs_message_delivered;
+    void message_delivered(const MessageDelivered& event);
+
+    bool wait_message(ReceiveAwaiter* awaiter);
+    ReceiveResult deliver(const Message& message, char *m);
+    ReceivedMessage lend(MessageHandle message);
+
+    bool validate_size(MessageData& data);
+    std::unique_ptr<Transmission> release_async(Transmission* transmission);
 
     Message create_message(std::string id, const MessageData& data);
     Transmission create_transmission(std::string id, const MessageData& data);
 
     bool enqueue(Transmission& transmission);
 
-    void send_routine();
 };
@@ -0,0 +1,172 @@
+#include "communication/sender_pool.h"
+
+SenderPool::SenderPool(uint32_t size)
+{
+    size = std::max<uint32_t>(size, 1);
+
+    for (uint32_t i = 0; i < size; i++)
+        workers.push_back(std::make_unique<Worker>(format("sender %u", i)));
+
+    for (uint32_t i = 0; i < size; i++)
+        workers[i]->thread = std::thread([this, i]() { routine(i); });
+}
+
+SenderPool::~SenderPool()
+{
+    stop();
+}
+
+void SenderPool::stop()
+{
+    if (stopping.exchange(true)) return;
+
+    for (auto& worker : workers)
+    {
+        worker->event.fetch_add(1);
+        worker->event.notify_all();
+    }
+
+    for (auto& worker : workers)
+        if (worker->thread.joinable()) worker->thread.join();
+
+    destroy_released();
+}
+
+uint32_t SenderPool::assign()
+{
+    return next_worker.fetch_add(1) % workers.size();
+}
+
+void SenderPool::schedule(Connection* connection)
+{
+    uint32_t home = connection->sender_worker;
+
+    if (workers[home]->queue.schedule(connection))
+        notify(home);
+}
+
+bool SenderPool::unschedule(Connection* connection)
+{
+    return workers[connection->sender_worker]->queue.cancel(connection);
+}
+
+void SenderPool::release(std::vector<std::shared_ptr<Connection>> connections)
+{
+    if (connections.empty() || stopping)
+        return;
+
+    mutex_released.lock();
+    for (std::shared_ptr<Connection>& connection : connections)
+        released.push_back(std::move(connection));
+    mutex_released.unlock();
+
+    has_released = true;
+    notify(0);
+}
+
+/**
+ * Destrói as conexões liberadas com release(). Retorna se havia alguma.
+*/
+bool SenderPool::destroy_released()
+{
+    if (!has_released.load(std::memory_order_relaxed) || !has_released.exchange(false))
+        return false;
+
+    std::vector<std::shared_ptr<Connection>> connections;
+    mutex_released.lock();
+    connections.swap(released);
+    mutex_released.unlock();
+
+    return true;
+}
+
+/**
+ * Acorda o worker de origem se ele estiver dormindo. Se ele estiver ocupado,
+ * acorda outro worker ocioso para roubar a conexão.
+*/
+void SenderPool::notify(uint32_t home)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (workers[home]->sleeping.exchange(false))
+    {
+        wake(*workers[home]);
+        return;
+    }
+
+    for (auto& worker : workers)
+    {
+        if (worker->sleeping.exchange(false))
+        {
+            wake(*worker);
+            return;
+        }
+    }
+}
+
+void SenderPool::wake(Worker& worker)
+{
+    worker.event.fetch_add(1);
+    worker.event.notify_one();
+}
+
+/**
+ * Próxima conexão para o worker `index`: primeiro da própria fila, depois
+ * das filas dos outros workers.
+*/
+Connection* SenderPool::take(uint32_t index)
+{
+    uint32_t size = workers.size();
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        Connection* connection = workers[(index + i) % size]->queue.try_consume();
+        if (connection) return connection;
+    }
+
+    return nullptr;
+}
+
+void SenderPool::routine(uint32_t index)
+{
+    Worker& worker = *workers[index];
+
+    while (!stopping)
+    {
+        destroy_released();
+
+        Connection* connection = take(index);
+
+        if (!connection)
+        {
+            uint32_t observed = worker.event.load();
+            worker.sleeping = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // Quem agendou antes de `sleeping` ser visível não vai acordar
+            // este worker, então as filas são olhadas mais uma vez.
+            connection = take(index);
+
+            if (!connection && has_released)
+            {
+                worker.sleeping = false;
+                continue;
+            }
+
+            if (!connection)
+            {
+                if (!stopping) worker.event.wait(observed);
+                worker.sleeping = false;
+                continue;
+            }
+
+            worker.sleeping = false;
+        }
+
+        connection->update();
+
+        uint32_t home = connection->sender_worker;
+        if (workers[home]->queue.finish(connection))
+            notify(home);
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "communication/connection.h"
+
+/**
+ * Threads que executam as atualizações das conexões (fragmentação,
+ * checksum e escrita no canal dos envios iniciados pela aplicação).
+ *
+ * Cada conexão tem um worker de origem, escolhido em rodízio, e é agendada
+ * na fila dele. Um worker sem trabalho na própria fila rouba conexões das
+ * filas dos outros. A ReadyQueue garante que uma conexão nunca é atualizada
+ * por dois workers ao mesmo tempo, então o protocolo continua single-thread
+ * por conexão.
+*/
+class SenderPool
+{
+    struct Worker {
+        Connection::UpdateQueue queue;
+
+        /**
+         * Contador no qual o worker dorme (futex) quando não há trabalho.
+        */
+        std::atomic<uint32_t> event{0};
+        std::atomic<bool> sleeping{false};
+
+        std::thread thread;
+
+        Worker(std::string name) : queue(name) {};
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<uint32_t> next_worker{0};
+    std::atomic<bool> stopping{false};
+
+    /**
+     * Conexões desfeitas esperando um worker destruí-las.
+    */
+    std::vector<std::shared_ptr<Connection>> released;
+    std::mutex mutex_released;
+    std::atomic<bool> has_released{false};
+
+    Connection* take(uint32_t index);
+    bool destroy_released();
+    void notify(uint32_t home);
+    void wake(Worker& worker);
+
+    void routine(uint32_t index);
+
+public:
+    SenderPool(uint32_t size);
+    ~SenderPool();
+
+    /**
+     * Escolhe o worker de origem de uma nova conexão.
+    */
+    uint32_t assign();
+
+    void schedule(Connection* connection);
+
+    /**
+     * Tira a conexão da fila do seu worker. Retorna false enquanto ela
+     * estiver sendo atualizada.
+    */
+    bool unschedule(Connection* connection);
+
+    /**
+     * Destrói as conexões em um dos workers em vez de na thread que chama.
+     * O destrutor da conexão espera o worker que a estiver atualizando, o
+     * que não pode acontecer na thread do TimerService, que atende os
+     * timers de todas as conexões.
+    */
+    void release(std::vector<std::shared_ptr<Connection>> connections);
+
+    void stop();
+};
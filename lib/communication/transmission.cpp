@@ -19,8 +19,15 @@ void Transmission::set_result(bool success) {
 void Transmission::release() {
     active = false;
     completed = true;
+
+    std::function<void(const TransmissionResult&)> callback = std::move(on_complete);
+    on_complete = nullptr;
+    TransmissionResult final_result = result;
+
     completed_sem.release();
-} 
+
+    if (callback) callback(final_result);
+}
 
 TransmissionResult Transmission::wait_result() {
     // trocar pra condition_variable
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <semaphore>
+#include <functional>
 
 #include "core/message.h"
 #include "utils/uuid.h"
@@ -28,6 +29,12 @@ public:
     bool completed = false;
     TransmissionResult result;
 
+    /**
+     * Chamado uma única vez quando a transmissão termina, na thread da
+     * biblioteca que a concluiu. Pode destruir a própria transmissão.
+    */
+    std::function<void(const TransmissionResult&)> on_complete;
+
     Transmission(std::string receiver_id, Message message);
 
     void set_result(bool success);
@@ -1,7 +1,38 @@
 
 #include "core/buffer.h"
 
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 buffer_termination::buffer_termination()
         : std::runtime_error("Buffer was terminated.") {}
 buffer_termination::buffer_termination(const std::string& msg)
         : std::runtime_error(msg) {}
+
+bool futex::wait(std::atomic<uint32_t>& word, uint32_t expected, int64_t timeout_us)
+{
+    timespec timeout;
+    timespec* timeout_ptr = nullptr;
+
+    if (timeout_us >= 0)
+    {
+        timeout.tv_sec = timeout_us / 1000000;
+        timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+        timeout_ptr = &timeout;
+    }
+
+    long result = syscall(
+        SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, timeout_ptr, nullptr, 0
+    );
+
+    return !(result == -1 && errno == ETIMEDOUT);
+}
+
+void futex::wake_all(std::atomic<uint32_t>& word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
@@ -1,10 +1,12 @@
 #pragma once
 
-#include <mutex>
-#include <semaphore>
-#include <condition_variable>
-#include <unordered_set>
-#include <queue>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
 
 #include "utils/log.h"
 
@@ -15,161 +17,366 @@ public:
 };
 
 
+/**
+ * Espera e despertar direto no futex do Linux. Usados no lugar de
+ * std::atomic::wait porque ele não aceita prazo.
+*/
+namespace futex
+{
+    /**
+     * Dorme enquanto `word` valer `expected`, por no máximo `timeout_us`
+     * microssegundos (negativo espera sem prazo). Retorna false só quando o
+     * prazo venceu; despertares espúrios retornam true.
+    */
+    bool wait(std::atomic<uint32_t>& word, uint32_t expected, int64_t timeout_us);
+
+    void wake_all(std::atomic<uint32_t>& word);
+}
+
+
+/**
+ * Fila circular limitada MPMC (múltiplos produtores e consumidores) sem
+ * locks, no estilo de Dmitry Vyukov: cada posição tem um número de sequência
+ * que diz se ela está livre para o produtor ou pronta para o consumidor da
+ * volta atual, então produtores e consumidores só disputam um CAS nos seus
+ * próprios contadores.
+ *
+ * As threads só bloqueiam quando a fila está vazia (consumidores) ou cheia
+ * (produtores), esperando em um contador atômico (futex no Linux). Quem
+ * libera espaço ou insere um item só faz a chamada de sistema para acordar
+ * alguém se houver threads esperando.
+*/
 template <typename T>
 class Buffer
 {
 public:
-    Buffer() {};
-    Buffer(uint32_t max_size) : max_size(max_size) {};
-    Buffer(std::string name) : name(name) {};
-    Buffer(std::string name, uint32_t max_size) : name(name), max_size(max_size) {};
+    Buffer(uint32_t max_size) : Buffer("", max_size) {};
+    Buffer(std::string name, uint32_t max_size) : name(name), max_size(max_size), cells(new Cell[max_size])
+    {
+        for (uint32_t i = 0; i < max_size; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    };
+
+    ~Buffer()
+    {
+        while (take());
+    }
 
-    bool empty() { return !buffer.size(); }
-    bool full() { return buffer.size() >= max_size; }
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    /**
+     * Tamanho aproximado: com produtores e consumidores ativos, o valor pode
+     * estar desatualizado assim que é lido.
+    */
+    std::size_t size()
+    {
+        uint64_t dequeued = dequeue_position.load(std::memory_order_acquire);
+        uint64_t enqueued = enqueue_position.load(std::memory_order_acquire);
+        return enqueued - dequeued;
+    }
+
+    bool empty() { return !size(); }
+    bool full() { return size() >= max_size; }
 
     T consume()
     {
-        while (empty() && !terminating) {
-            log_trace("Waiting to consume on [", name, "] buffer.");
-            std::unique_lock<std::mutex> lock(empty_mutex);
-            empty_cv.wait(lock);
-        }
+        while (true)
+        {
+            if (terminating) throw buffer_termination("Exiting buffer.");
 
-        if (terminating) throw buffer_termination("Exiting buffer.");
+            std::optional<T> item = try_consume();
+            if (item) return std::move(*item);
 
-        mutex.lock();
+            log_trace("Waiting to consume on [", name, "] buffer.");
+            wait(produced, waiting_consumers, -1);
+        }
+    };
 
-        T item = buffer.front();
-        buffer.pop();
+    /**
+     * Como consume(), mas desiste em `deadline` e retorna vazio.
+    */
+    std::optional<T> consume_until(std::chrono::steady_clock::time_point deadline)
+    {
+        while (true)
+        {
+            if (terminating) throw buffer_termination("Exiting buffer.");
 
-        full_cv.notify_one();
+            std::optional<T> item = try_consume();
+            if (item) return item;
 
-        log_trace("Consumed item to [", name, "] buffer.");
+            auto remaining = deadline - std::chrono::steady_clock::now();
+            if (remaining <= std::chrono::steady_clock::duration::zero()) return std::nullopt;
 
-        mutex.unlock();
+            log_trace("Waiting to consume on [", name, "] buffer.");
+            wait(produced, waiting_consumers, std::chrono::ceil<std::chrono::microseconds>(remaining).count());
+        }
+    }
 
-        return item;
-    };
+    std::optional<T> consume_for(std::chrono::steady_clock::duration timeout)
+    {
+        return consume_until(std::chrono::steady_clock::now() + timeout);
+    }
 
     void produce(const T &item)
     {
-        while (full() && !terminating) {
+        produce(T(item));
+    }
+
+    void produce(T &&item)
+    {
+        while (true)
+        {
+            if (terminating) throw buffer_termination("Exiting buffer.");
+
+            if (try_produce(std::move(item))) return;
+
             log_trace("Waiting to produce on [", name, "] buffer.");
-            std::unique_lock<std::mutex> lock(full_mutex);
-            full_cv.wait(lock);
+            wait(consumed, waiting_producers, -1);
         }
+    }
 
-        if (terminating) throw buffer_termination("Exiting buffer.");
-
-        mutex.lock();
+    /**
+     * Insere sem bloquear. Retorna false, sem mover o item, se a fila estiver
+     * cheia.
+    */
+    bool try_produce(T &&item)
+    {
+        uint64_t position = enqueue_position.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        while (true)
+        {
+            cell = &cells[position % max_size];
+            uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+            int64_t difference = (int64_t) sequence - (int64_t) position;
+
+            if (!difference)
+            {
+                if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (difference < 0)
+                return false;
+            else
+                position = enqueue_position.load(std::memory_order_relaxed);
+        }
 
-        buffer.push(item);
-        empty_cv.notify_one();
+        new (cell->storage) T(std::move(item));
+        cell->sequence.store(position + 1, std::memory_order_release);
 
         log_trace("Produced item to [", name, "] buffer.");
+        wake(produced, waiting_consumers);
 
-        mutex.unlock();
+        return true;
     }
 
-    void terminate() {
-        terminating = true;
-        empty_cv.notify_all();
-        full_cv.notify_all();  
-    }
-    
-    bool can_consume()
+    /**
+     * Remove sem bloquear, ou retorna vazio se não houver itens.
+    */
+    std::optional<T> try_consume()
     {
-        return buffer.size() > 0;
+        std::optional<T> item = take();
+        if (item) wake_producers();
+
+        return item;
     }
 
-    bool can_produce()
+    /**
+     * Remove sem bloquear até `items.size()` itens, acordando os produtores
+     * uma única vez. Retorna quantos itens foram escritos em `items`.
+    */
+    std::size_t try_consume_many(std::span<T> items)
     {
-        return buffer.size() < max_size;
+        return try_consume_many(items, [](T&& item) { return std::move(item); });
     }
 
-private:
-    std::string name;
-    uint32_t max_size = UINT32_MAX;
-
-    std::queue<T> buffer;
-    std::mutex mutex;
-    bool terminating = false;
+    /**
+     * Como try_consume_many(items), mas escreve `convert(item)` direto em
+     * `items`, sem um vetor intermediário de T.
+    */
+    template <typename Out, typename Convert>
+    std::size_t try_consume_many(std::span<Out> items, Convert convert)
+    {
+        std::size_t count = 0;
 
-    std::mutex empty_mutex;
-    std::condition_variable empty_cv;
-    std::mutex full_mutex;
-    std::condition_variable full_cv;
+        while (count < items.size())
+        {
+            std::optional<T> item = take();
+            if (!item) break;
 
-};
+            items[count++] = convert(std::move(*item));
+        }
 
+        if (count) wake_producers();
 
-template<typename T>
-class BufferSet {
-    std::unordered_set<T> values;
-    std::mutex values_mutex;
+        return count;
+    }
 
-    std::mutex empty_mutex;
-    std::condition_variable empty_cv;
-    std::mutex full_mutex;
-    std::condition_variable full_cv;
+    void terminate() {
+        terminating = true;
 
-    std::string name;
-    uint32_t max_size = UINT32_MAX;
+        produced.fetch_add(1);
+        futex::wake_all(produced);
+        consumed.fetch_add(1);
+        futex::wake_all(consumed);
+    }
+    
+    bool can_consume()
+    {
+        return !empty();
+    }
 
-    bool terminating = false;
-public:
-    BufferSet() {};
-    BufferSet(uint32_t max_size) : max_size(max_size) {};
-    BufferSet(std::string name) : name(name) {};
-    BufferSet(std::string name, uint32_t max_size) : name(name), max_size(max_size) {};
+    bool can_produce()
+    {
+        return !full();
+    }
 
-    bool empty() { return !values.size(); }
-    bool full() { return values.size() >= max_size; }
+    /**
+     * Chamado na thread que consumiu, após o próximo consumo que se seguir a
+     * um notify_on_space(). Deve ser definido antes de a fila ser usada.
+    */
+    void on_space(std::function<void()> callback)
+    {
+        space_callback = callback;
+    }
 
-    void produce(const T& value) {
-        while (full() && !terminating) {
-            log_trace("Waiting to produce on [", name, "] buffer.");
-            std::unique_lock<std::mutex> lock(full_mutex);
-            full_cv.wait(lock);
-        }
+    /**
+     * Pede um aviso (on_space()) quando houver espaço, para quem recusa
+     * itens com a fila cheia em vez de esperar em produce(). Se o espaço
+     * tiver sido liberado antes do pedido, o aviso só vem no consumo
+     * seguinte; quem chama deve conferir available() depois.
+    */
+    void notify_on_space()
+    {
+        space_wanted.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
 
-        if (terminating) throw buffer_termination("Exiting buffer.");
+    /**
+     * Quantos itens ainda podem ser produzidos antes do buffer encher.
+    */
+    std::size_t available()
+    {
+        std::size_t used = size();
+        return used < max_size ? max_size - used : 0;
+    }
 
-        values_mutex.lock();
+private:
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
 
-        values.emplace(value);
-        empty_cv.notify_one();
+    std::string name;
+    uint32_t max_size;
+    std::unique_ptr<Cell[]> cells;
+
+    alignas(64) std::atomic<uint64_t> enqueue_position{0};
+    alignas(64) std::atomic<uint64_t> dequeue_position{0};
+
+    /**
+     * Contadores de eventos nos quais as threads esperam. Mudam quando um
+     * item é produzido/consumido e havia alguém esperando.
+    */
+    alignas(64) std::atomic<uint32_t> produced{0};
+    std::atomic<uint32_t> waiting_consumers{0};
+    alignas(64) std::atomic<uint32_t> consumed{0};
+    std::atomic<uint32_t> waiting_producers{0};
+
+    std::atomic<bool> terminating{false};
+
+    std::atomic<bool> space_wanted{false};
+    std::function<void()> space_callback;
+
+    /**
+     * Retira o próximo item publicado, sem acordar os produtores.
+    */
+    std::optional<T> take()
+    {
+        uint64_t position = dequeue_position.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        while (true)
+        {
+            cell = &cells[position % max_size];
+            uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+            int64_t difference = (int64_t) sequence - (int64_t) (position + 1);
+
+            if (!difference)
+            {
+                if (dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (difference < 0)
+                return std::nullopt;
+            else
+                position = dequeue_position.load(std::memory_order_relaxed);
+        }
 
-        log_trace("Produced item to [", name, "] buffer.");
+        T* stored = std::launder(reinterpret_cast<T*>(cell->storage));
+        std::optional<T> item(std::move(*stored));
+        stored->~T();
+        cell->sequence.store(position + max_size, std::memory_order_release);
 
-        values_mutex.unlock();
+        log_trace("Consumed item to [", name, "] buffer.");
+        return item;
     }
 
-    T consume() {
-        while (empty() && !terminating) {
-            log_trace("Waiting to consume on [", name, "] buffer.");
-            std::unique_lock<std::mutex> lock(empty_mutex);
-            empty_cv.wait(lock);
-        }
-
-        if (terminating) throw buffer_termination("Exiting buffer.");
+    /**
+     * Espera até `event` mudar ou `timeout_us` vencer. O contador é lido
+     * antes de registrar a espera e a condição é testada de novo depois,
+     * então um evento entre o teste do chamador e a espera não é perdido.
+     * Quem acorda as threads zera `waiting`, então só a primeira operação
+     * depois de alguém começar a esperar faz a chamada de sistema.
+    */
+    void wait(std::atomic<uint32_t>& event, std::atomic<uint32_t>& waiting, int64_t timeout_us)
+    {
+        uint32_t observed = event.load();
+        waiting.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
 
-        values_mutex.lock();
+        bool ready = &event == &produced ? readable() : writable();
+        if (!ready && !terminating) futex::wait(event, observed, timeout_us);
+    }
 
-        T v = *values.begin();
-        values.erase(values.begin());
-        full_cv.notify_one();
+    /**
+     * Se a próxima posição a consumir já foi publicada.
+    */
+    bool readable()
+    {
+        uint64_t position = dequeue_position.load(std::memory_order_relaxed);
+        return cells[position % max_size].sequence.load(std::memory_order_acquire) == position + 1;
+    }
 
-        log_trace("Consumed item to [", name, "] buffer.");
+    /**
+     * Se a próxima posição a produzir já foi liberada.
+    */
+    bool writable()
+    {
+        uint64_t position = enqueue_position.load(std::memory_order_relaxed);
+        return cells[position % max_size].sequence.load(std::memory_order_acquire) == position;
+    }
 
-        values_mutex.unlock();
+    /**
+     * Chamado depois de retirar itens: acorda os produtores esperando e
+     * atende um pedido de notify_on_space(). A barreira de wake() ordena a
+     * leitura de `space_wanted` depois da retirada.
+    */
+    void wake_producers()
+    {
+        wake(consumed, waiting_producers);
 
-        return v;
+        if (space_wanted.load(std::memory_order_relaxed) && space_wanted.exchange(false) && space_callback)
+            space_callback();
     }
 
-    void terminate() {
-        terminating = true;
-        empty_cv.notify_all();
-        full_cv.notify_all();  
+    void wake(std::atomic<uint32_t>& event, std::atomic<uint32_t>& waiting)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!waiting.load(std::memory_order_relaxed) || !waiting.exchange(0)) return;
+
+        event.fetch_add(1);
+        futex::wake_all(event);
     }
 };
@@ -1,8 +1,26 @@
 #pragma once
 
 #define INTERMEDIARY_BUFFER_ITEMS 100
+#define MESSAGE_POOL_ITEMS 128
 #define MAX_ENQUEUED_TRANSMISSIONS 100
+#define RECEIVE_BATCH_SIZE 32
 
 #define ACK_TIMEOUT 1000
+#define MIN_ACK_TIMEOUT 50
+#define MAX_ACK_TIMEOUT 10000
 #define HANDSHAKE_TIMEOUT 10000
-#define MAX_PACKET_TRIES 5
\ No newline at end of file
+#define CONNECTION_IDLE_TIMEOUT 60000
+#define MIN_CONNECTION_IDLE_TIMEOUT 1000
+#define MAX_PACKET_TRIES 5
+
+#define INITIAL_CONGESTION_WINDOW 10
+#define MIN_CONGESTION_WINDOW 2
+#define MAX_CONGESTION_WINDOW 1024
+
+#define MAX_ZERO_WINDOW_PROBE_INTERVAL 2000
+
+#define TRACE_RECORDS (1 << 20)
+
+#define STATS_PEERS_PER_CHUNK 64
+#define STATS_CHUNKS 4096
+#define STATS_LAYERS 8
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <chrono>
+
+#include "core/counters.h"
+
+static std::atomic<uint64_t> next_counters_id{1};
+
+/**
+ * Tabela usada pela última instância que a thread tocou, para que a busca
+ * em `tables` (com lock) só aconteça na primeira vez.
+*/
+static thread_local uint64_t cached_id = 0;
+static thread_local void* cached_table = nullptr;
+
+/**
+ * Tempo das camadas medidas dentro da camada atual desta thread.
+*/
+static thread_local uint64_t nested_ns = 0;
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Counters::ThreadTable::~ThreadTable()
+{
+    for (std::atomic<Chunk*>& chunk : chunks)
+        delete chunk.load(std::memory_order_relaxed);
+}
+
+Counters::PeerSlot* Counters::ThreadTable::slot(uint32_t peer)
+{
+    uint32_t index = peer / STATS_PEERS_PER_CHUNK;
+    if (index >= STATS_CHUNKS)
+        return nullptr;
+
+    // Só a própria thread cria blocos na sua tabela; o release publica o
+    // bloco zerado para snapshot().
+    Chunk* chunk = chunks[index].load(std::memory_order_acquire);
+    if (!chunk)
+    {
+        chunk = new Chunk{};
+        chunks[index].store(chunk, std::memory_order_release);
+    }
+    return &chunk->peers[peer % STATS_PEERS_PER_CHUNK];
+}
+
+Counters::Counters() : id(next_counters_id.fetch_add(1, std::memory_order_relaxed)) {}
+
+Counters::ThreadTable& Counters::local()
+{
+    if (cached_id == id)
+        return *static_cast<ThreadTable*>(cached_table);
+    return register_thread();
+}
+
+Counters::ThreadTable& Counters::register_thread()
+{
+    std::lock_guard<std::mutex> lock(mutex_tables);
+
+    std::unique_ptr<ThreadTable>& table = tables[std::this_thread::get_id()];
+    if (!table)
+        table = std::make_unique<ThreadTable>();
+
+    cached_id = id;
+    cached_table = table.get();
+    return *table;
+}
+
+void Counters::add_layer_time(int layer, bool receiving, uint64_t ns)
+{
+    if (layer < 0 || layer >= STATS_LAYERS)
+        return;
+
+    LayerSlot& slot = local().layers[layer];
+    if (receiving)
+    {
+        bump(slot.receive_ns, ns);
+        bump(slot.receive_calls, 1);
+    }
+    else
+    {
+        bump(slot.send_ns, ns);
+        bump(slot.send_calls, 1);
+    }
+}
+
+std::unordered_map<uint32_t, CounterValues> Counters::snapshot()
+{
+    std::lock_guard<std::mutex> lock(mutex_tables);
+
+    std::unordered_map<uint32_t, CounterValues> result;
+    for (auto& [thread, table] : tables)
+    {
+        for (uint32_t index = 0; index < STATS_CHUNKS; index++)
+        {
+            Chunk* chunk = table->chunks[index].load(std::memory_order_acquire);
+            if (!chunk)
+                continue;
+
+            for (uint32_t i = 0; i < STATS_PEERS_PER_CHUNK; i++)
+            {
+                PeerSlot& slot = chunk->peers[i];
+
+                bool touched = false;
+                CounterValues values;
+                for (std::size_t c = 0; c < COUNTER_COUNT; c++)
+                {
+                    values[c] = slot.values[c].load(std::memory_order_relaxed);
+                    touched |= values[c] != 0;
+                }
+                if (!touched)
+                    continue;
+
+                CounterValues& total = result.try_emplace(index * STATS_PEERS_PER_CHUNK + i, CounterValues{}).first->second;
+                for (std::size_t c = 0; c < COUNTER_COUNT; c++)
+                    total[c] += values[c];
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<LayerStats> Counters::snapshot_layers(std::size_t layers)
+{
+    std::lock_guard<std::mutex> lock(mutex_tables);
+
+    std::vector<LayerStats> result(std::min<std::size_t>(layers, STATS_LAYERS));
+    for (auto& [thread, table] : tables)
+    {
+        for (std::size_t layer = 0; layer < result.size(); layer++)
+        {
+            LayerSlot& slot = table->layers[layer];
+            result[layer].send_ns += slot.send_ns.load(std::memory_order_relaxed);
+            result[layer].send_calls += slot.send_calls.load(std::memory_order_relaxed);
+            result[layer].receive_ns += slot.receive_ns.load(std::memory_order_relaxed);
+            result[layer].receive_calls += slot.receive_calls.load(std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+
+Counters::LayerScope::LayerScope(Counters& counters, int layer, bool receiving)
+    : counters(counters), layer(layer), receiving(receiving), start(now_ns()), outer_nested_ns(nested_ns)
+{
+    nested_ns = 0;
+}
+
+Counters::LayerScope::~LayerScope()
+{
+    uint64_t elapsed = now_ns() - start;
+    counters.add_layer_time(layer, receiving, elapsed - std::min(elapsed, nested_ns));
+    nested_ns = outer_nested_ns + elapsed;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "core/constants.h"
+
+/**
+ * Contadores por nó, indexados pelo índice do nó.
+*/
+enum class Counter : uint8_t
+{
+    PACKETS_SENT,
+    BYTES_SENT,
+    PACKETS_RECEIVED,
+    BYTES_RECEIVED,
+    RETRANSMISSIONS,
+    TIMEOUTS,
+    /**
+     * Fragmentos recebidos de novo depois de já fazerem parte da mensagem.
+    */
+    DUPLICATE_FRAGMENTS,
+    CHECKSUM_FAILURES,
+    /**
+     * Pacotes e mensagens descartados por chegarem antes da vez.
+    */
+    REORDER_DROPS,
+    /**
+     * Fragmentos recusados com janela zero por falta de espaço no buffer
+     * da aplicação.
+    */
+    BUFFER_FULL_DROPS,
+    COUNT
+};
+
+constexpr std::size_t COUNTER_COUNT = (std::size_t) Counter::COUNT;
+
+using CounterValues = std::array<uint64_t, COUNTER_COUNT>;
+
+/**
+ * Tempo gasto em uma camada, sem o das camadas que ela chamou.
+*/
+struct LayerStats
+{
+    std::string name;
+    uint64_t send_ns = 0;
+    uint64_t send_calls = 0;
+    uint64_t receive_ns = 0;
+    uint64_t receive_calls = 0;
+};
+
+/**
+ * Contadores de desempenho de uma instância, sem lock no caminho dos
+ * pacotes. Cada thread escreve somente na sua própria tabela, alinhada a
+ * linhas de cache, com load + store relaxados (sem instrução atômica de
+ * leitura-modificação-escrita); snapshot() soma as tabelas de todas as
+ * threads. As tabelas vivem até a instância ser destruída, de modo que os
+ * valores de threads encerradas não se perdem.
+ *
+ * Os contadores de cada thread são alocados em blocos de
+ * STATS_PEERS_PER_CHUNK nós, só para os nós que ela de fato tocou.
+*/
+class Counters
+{
+    struct alignas(64) PeerSlot
+    {
+        std::atomic<uint64_t> values[COUNTER_COUNT];
+    };
+
+    struct Chunk
+    {
+        PeerSlot peers[STATS_PEERS_PER_CHUNK];
+    };
+
+    struct alignas(64) LayerSlot
+    {
+        std::atomic<uint64_t> send_ns;
+        std::atomic<uint64_t> send_calls;
+        std::atomic<uint64_t> receive_ns;
+        std::atomic<uint64_t> receive_calls;
+    };
+
+    struct alignas(64) ThreadTable
+    {
+        LayerSlot layers[STATS_LAYERS] = {};
+        std::atomic<Chunk*> chunks[STATS_CHUNKS] = {};
+
+        ~ThreadTable();
+
+        PeerSlot* slot(uint32_t peer);
+    };
+
+    /**
+     * Identifica a instância no cache por thread; não é reaproveitado, ao
+     * contrário do endereço.
+    */
+    const uint64_t id;
+
+    std::unordered_map<std::thread::id, std::unique_ptr<ThreadTable>> tables;
+    std::mutex mutex_tables;
+
+    ThreadTable& local();
+    ThreadTable& register_thread();
+
+    static void bump(std::atomic<uint64_t>& value, uint64_t amount)
+    {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+public:
+    Counters();
+
+    Counters(const Counters&) = delete;
+    Counters& operator=(const Counters&) = delete;
+
+    /**
+     * Nós com índice a partir de STATS_CHUNKS * STATS_PEERS_PER_CHUNK não
+     * são contados.
+    */
+    void add(uint32_t peer, Counter counter, uint64_t amount = 1)
+    {
+        if (PeerSlot* slot = local().slot(peer))
+            bump(slot->values[(std::size_t) counter], amount);
+    }
+
+    void add_layer_time(int layer, bool receiving, uint64_t ns);
+
+    /**
+     * Soma dos contadores de cada nó com algum valor, indexada pelo índice
+     * do nó.
+    */
+    std::unordered_map<uint32_t, CounterValues> snapshot();
+
+    /**
+     * Soma dos tempos de cada camada, das STATS_LAYERS primeiras.
+    */
+    std::vector<LayerStats> snapshot_layers(std::size_t layers);
+
+    /**
+     * Mede o tempo de uma chamada de camada enquanto existir. O tempo das
+     * camadas medidas dentro dela é descontado, para que cada camada conte
+     * só o próprio trabalho.
+    */
+    class LayerScope
+    {
+        Counters& counters;
+        int layer;
+        bool receiving;
+        uint64_t start;
+        uint64_t outer_nested_ns;
+
+    public:
+        LayerScope(Counters& counters, int layer, bool receiving);
+        ~LayerScope();
+
+        LayerScope(const LayerScope&) = delete;
+        LayerScope& operator=(const LayerScope&) = delete;
+    };
+};
@@ -4,13 +4,25 @@ Event::Event() {}
 
 PacketAckReceived::PacketAckReceived(Packet& ack_packet) : ack_packet(ack_packet) {}
 
+WindowUpdateReceived::WindowUpdateReceived(Packet& update_packet) : update_packet(update_packet) {}
+
+ReceiveBatchStarted::ReceiveBatchStarted() {}
+
+ReceiveBatchFinished::ReceiveBatchFinished() {}
+
 TransmissionFail::TransmissionFail(Packet& faulty_packet) : faulty_packet(faulty_packet) {}
 
-TransmissionComplete::TransmissionComplete(UUID uuid, const SocketAddress& remote_address, uint32_t msg_num)
-    : uuid(uuid), remote_address(remote_address), msg_num(msg_num) {}
+TransmissionComplete::TransmissionComplete(UUID uuid, const SocketAddress& remote_address, uint32_t remote_peer, uint32_t msg_num)
+    : uuid(uuid), remote_address(remote_address), remote_peer(remote_peer), msg_num(msg_num) {}
 
 MessageDefragmentationIsComplete::MessageDefragmentationIsComplete(Packet& packet) : packet(packet) {}
 
 ForwardDefragmentedMessage::ForwardDefragmentedMessage(Packet& packet) : packet(packet) {}
 
+MessageDelivered::MessageDelivered() {}
+
 PipelineCleanup::PipelineCleanup(Message& message) : message(message) {}
+
+PeerRemoved::PeerRemoved(uint32_t peer) : peer(peer) {}
+
+PeerIdle::PeerIdle(uint32_t peer) : peer(peer) {}
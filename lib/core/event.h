@@ -2,69 +2,97 @@
 
 #include "core/packet.h"
 
-enum EventType {
-    BASE = -1,
-    PACKET_ACK_RECEIVED = 0,
-    TRANSMISSION_FAIL = 1,
-    TRANSMISSION_COMPLETE = 2,
-    MESSAGE_DEFRAGMENTATION_IS_COMPLETE = 3,
-    FORWARD_DEFRAGMENTED_MESSAGE = 4,
-    PIPELINE_CLEANUP = 5
-};
-
 struct Event {
-    static EventType type() { return EventType::BASE; }
-
 protected:
     Event();
 };
 
 struct PacketAckReceived : public Event {
-    static EventType type() { return EventType::PACKET_ACK_RECEIVED; }
-
     Packet& ack_packet;
 
     PacketAckReceived(Packet& ack_packet);
 };
 
-struct TransmissionFail : public Event {
-    static EventType type() { return EventType::TRANSMISSION_FAIL; }
+struct WindowUpdateReceived : public Event {
+    Packet& update_packet;
+
+    WindowUpdateReceived(Packet& update_packet);
+};
 
+/**
+ * O canal leu vários pacotes de uma vez e vai repassá-los em sequência na
+ * thread atual. Camadas podem acumular trabalho até ReceiveBatchFinished.
+*/
+struct ReceiveBatchStarted : public Event {
+    ReceiveBatchStarted();
+};
+
+struct ReceiveBatchFinished : public Event {
+    ReceiveBatchFinished();
+};
+
+struct TransmissionFail : public Event {
     Packet& faulty_packet;
 
     TransmissionFail(Packet& faulty_packet);
+
+    uint32_t peer() const { return faulty_packet.meta.peer; }
 };
 
 struct TransmissionComplete : public Event {
-    static EventType type() { return EventType::TRANSMISSION_COMPLETE; }
-
     UUID uuid;
     SocketAddress remote_address;
+    uint32_t remote_peer;
     uint32_t msg_num;
 
-    TransmissionComplete(UUID transmission_uuid, const SocketAddress& remote_address, uint32_t msg_num);
+    TransmissionComplete(UUID transmission_uuid, const SocketAddress& remote_address, uint32_t remote_peer, uint32_t msg_num);
+
+    uint32_t peer() const { return remote_peer; }
 };
 
 struct MessageDefragmentationIsComplete : public Event {
-    static EventType type() { return EventType::MESSAGE_DEFRAGMENTATION_IS_COMPLETE; }
-
     Packet& packet; // TODO: Dá pra trocar pelo UUID da mensagem depois de implementarmos
 
     MessageDefragmentationIsComplete(Packet& packet);
+
+    uint32_t peer() const { return packet.meta.peer; }
 };
 
 struct ForwardDefragmentedMessage : public Event {
-    static EventType type() { return EventType::FORWARD_DEFRAGMENTED_MESSAGE; }
-
     Packet& packet; // TODO: Dá pra trocar pelo UUID da mensagem depois de implementarmos
 
     ForwardDefragmentedMessage(Packet& packet);
 };
 
-struct PipelineCleanup : public Event {
-    static EventType type() { return EventType::PIPELINE_CLEANUP; }
+/**
+ * Uma mensagem foi entregue no buffer da aplicação.
+*/
+struct MessageDelivered : public Event {
+    MessageDelivered();
+};
 
+struct PipelineCleanup : public Event {
     Message& message;
 
     PipelineCleanup(Message& message);
 };
+
+/**
+ * Um nó saiu do grupo. As camadas descartam o estado que guardavam para ele.
+*/
+struct PeerRemoved : public Event {
+    uint32_t peer;
+
+    PeerRemoved(uint32_t peer);
+};
+
+/**
+ * A conexão com um nó ficou ociosa e foi desfeita. As camadas liberam o
+ * estado que guardavam para ele, se não houver nada pendente; ele é criado
+ * de novo no próximo contato.
+*/
+struct PeerIdle : public Event {
+    uint32_t peer;
+
+    PeerIdle(uint32_t peer);
+};
@@ -1,39 +1,50 @@
 #pragma once
 
-#include <vector>
-#include <functional>
+#include <tuple>
 #include "utils/log.h"
 #include "utils/observer.h"
 #include "core/event.h"
 
 
-class EventBus {
-    std::unordered_map<EventType, Subject<Event>> subjects;
+/**
+ * Cada tipo de evento tem a sua lista de observadores, escolhida em tempo
+ * de compilação pelo tipo notificado. Notificar um evento que não está na
+ * lista de tipos do barramento é erro de compilação.
+ *
+ * Eventos de um único par (que têm peer()) são observados uma vez pelo
+ * GroupRegistry, que os entrega à conexão daquele nó pelo índice.
+*/
+template <typename... Events>
+class BasicEventBus {
+    std::tuple<Subject<Events>...> subjects;
 
 public:
     void clear() {
-        subjects.clear();
+        std::apply([](auto&... subject) { (subject.clear(), ...); }, subjects);
     }
 
     template <typename T>
     void attach(Observer<T>& observer) {
-        EventType type = T::type();
-
-        if (!subjects.contains(type)) {
-            subjects.emplace(type, Subject<Event>());
-        }
-
-        Subject<T>* subject = reinterpret_cast<Subject<T>*>(&subjects.at(type));
-        subject->attach(observer);
+        std::get<Subject<T>>(subjects).attach(observer);
     }
 
     template <typename T>
     void notify(const T& event) {
-        EventType type = event.type();
-
-        if (!subjects.contains(type)) return;
-
-        Subject<Event>& subject = subjects.at(type);
-        subject.notify(event);
+        std::get<Subject<T>>(subjects).notify(event);
     }
 };
+
+using EventBus = BasicEventBus<
+    PacketAckReceived,
+    WindowUpdateReceived,
+    ReceiveBatchStarted,
+    ReceiveBatchFinished,
+    TransmissionFail,
+    TransmissionComplete,
+    MessageDefragmentationIsComplete,
+    ForwardDefragmentedMessage,
+    MessageDelivered,
+    PipelineCleanup,
+    PeerRemoved,
+    PeerIdle
+>;
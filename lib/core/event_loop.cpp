@@ -0,0 +1,134 @@
+#include "core/event_loop.h"
+
+#include "utils/log.h"
+
+static thread_local EventLoop* current_loop = nullptr;
+
+/**
+ * Corrotina que envolve as tarefas de spawn(). Ela se destrói ao terminar,
+ * já que ninguém a aguarda.
+*/
+struct EventLoop::Detached {
+    struct promise_type {
+        Detached get_return_object()
+        {
+            return Detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+EventLoop::Detached EventLoop::run_detached(EventLoop* loop, Task<void> task)
+{
+    try {
+        co_await std::move(task);
+    }
+    catch (const std::exception& err) {
+        log_error("Spawned task failed: ", err.what());
+    }
+
+    loop->task_finished();
+}
+
+EventLoop::EventLoop(uint32_t size)
+{
+    if (!size) size = 1;
+
+    for (uint32_t i = 0; i < size; i++)
+        threads.emplace_back(&EventLoop::routine, this);
+}
+
+EventLoop::~EventLoop()
+{
+    stop();
+}
+
+EventLoop* EventLoop::current()
+{
+    return current_loop;
+}
+
+void EventLoop::resume_on(EventLoop* loop, std::coroutine_handle<> handle)
+{
+    if (loop) loop->post(handle);
+    else handle.resume();
+}
+
+void EventLoop::post(std::coroutine_handle<> handle)
+{
+    mutex.lock();
+    ready.push_back(handle);
+    mutex.unlock();
+
+    has_work.notify_one();
+}
+
+void EventLoop::spawn(Task<void> task)
+{
+    mutex.lock();
+    running_tasks++;
+    mutex.unlock();
+
+    post(run_detached(this, std::move(task)).handle);
+}
+
+void EventLoop::task_finished()
+{
+    std::lock_guard lock(mutex);
+    if (--running_tasks == 0) tasks_done.notify_all();
+}
+
+void EventLoop::wait()
+{
+    std::unique_lock lock(mutex);
+    tasks_done.wait(lock, [this] { return running_tasks == 0; });
+}
+
+void EventLoop::stop()
+{
+    mutex.lock();
+    stopping = true;
+    mutex.unlock();
+
+    has_work.notify_all();
+
+    for (std::thread& thread : threads)
+    {
+        if (thread.joinable()) thread.join();
+    }
+}
+
+void EventLoop::routine()
+{
+    current_loop = this;
+    log_info("Initialized event loop thread.");
+
+    while (true)
+    {
+        std::unique_lock lock(mutex);
+        has_work.wait(lock, [this] { return stopping || !ready.empty(); });
+
+        if (stopping) break;
+
+        std::coroutine_handle<> handle = ready.front();
+        ready.pop_front();
+        lock.unlock();
+
+        handle.resume();
+    }
+
+    current_loop = nullptr;
+}
+
+void EventLoop::SleepAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    EventLoop* target = &loop;
+    loop.timer.add(interval_ms, [target, handle]() { target->post(handle); });
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/task.h"
+#include "utils/date.h"
+
+/**
+ * Conjunto pequeno de threads que executa corrotinas. Uma corrotina
+ * suspensa em uma operação da biblioteca (co_send, co_receive, sleep) não
+ * ocupa thread nenhuma: quem conclui a operação (a thread de recepção do
+ * canal, o TimerService) só devolve a corrotina à fila do loop.
+ *
+ * Corrotinas ainda suspensas quando o loop é destruído nunca são
+ * retomadas.
+*/
+class EventLoop
+{
+    std::deque<std::coroutine_handle<>> ready;
+    std::mutex mutex;
+    std::condition_variable has_work;
+    bool stopping = false;
+
+    /**
+     * Tarefas criadas com spawn() que ainda não terminaram.
+    */
+    size_t running_tasks = 0;
+    std::condition_variable tasks_done;
+
+    Timer timer;
+
+    std::vector<std::thread> threads;
+
+    void routine();
+    void task_finished();
+
+    struct Detached;
+    static Detached run_detached(EventLoop* loop, Task<void> task);
+
+public:
+    EventLoop(uint32_t size);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * Loop da thread atual, ou nullptr fora das threads de um EventLoop.
+    */
+    static EventLoop* current();
+
+    /**
+     * Retoma `handle` em uma thread de `loop`. Sem loop, retoma na thread
+     * atual.
+    */
+    static void resume_on(EventLoop* loop, std::coroutine_handle<> handle);
+
+    void post(std::coroutine_handle<> handle);
+
+    /**
+     * Executa `task` no loop sem aguardar o resultado. Exceções que escapam
+     * da tarefa são registradas no log.
+    */
+    void spawn(Task<void> task);
+
+    /**
+     * Bloqueia até todas as tarefas criadas com spawn() terminarem.
+    */
+    void wait();
+
+    void stop();
+
+    struct SleepAwaiter {
+        EventLoop& loop;
+        int interval_ms;
+
+        bool await_ready() { return interval_ms <= 0; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() {}
+    };
+
+    /**
+     * Suspende a corrotina atual por `interval_ms` sem ocupar a thread.
+    */
+    SleepAwaiter sleep(int interval_ms) { return SleepAwaiter{*this, interval_ms}; }
+};
@@ -13,6 +13,11 @@ enum MessageType
     CONTROL = 1,
 };
 
+/**
+ * Índice de um endereço que não pertence ao grupo.
+*/
+inline constexpr uint32_t UNKNOWN_PEER = UINT32_MAX;
+
 struct Message
 {
     inline const static int MAX_SIZE = 65536;
@@ -26,6 +31,12 @@ struct Message
     char data[MAX_SIZE];
     std::size_t length;
 
+    /**
+     * Índice no GroupRegistry do nó do outro lado: o destino de mensagens
+     * enviadas, a origem das recebidas (resolvida pelo canal).
+    */
+    uint32_t peer = UNKNOWN_PEER;
+
     std::string to_string() const
     {
         return format("%s -> %s", origin.to_string().c_str(), destination.to_string().c_str());
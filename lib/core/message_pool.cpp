@@ -0,0 +1,45 @@
+#include "core/message_pool.h"
+
+MessagePool& MessagePool::instance()
+{
+    static MessagePool pool;
+    return pool;
+}
+
+MessagePool::~MessagePool()
+{
+    for (Message* message : free_messages)
+        delete message;
+}
+
+Message* MessagePool::acquire()
+{
+    mutex.lock();
+
+    if (free_messages.empty())
+    {
+        mutex.unlock();
+        return new Message;
+    }
+
+    Message* message = free_messages.back();
+    free_messages.pop_back();
+
+    mutex.unlock();
+    return message;
+}
+
+void MessagePool::release(Message* message)
+{
+    mutex.lock();
+
+    if (free_messages.size() < MESSAGE_POOL_ITEMS)
+    {
+        free_messages.push_back(message);
+        message = nullptr;
+    }
+
+    mutex.unlock();
+
+    delete message;
+}
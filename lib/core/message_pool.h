@@ -0,0 +1,84 @@
+#pragma once
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "core/message.h"
+
+/**
+ * Blocos de Message reaproveitados pela remontagem de mensagens recebidas.
+ * Uma Message ocupa mais de 64 KB, então em vez de copiá-la entre as
+ * camadas e o buffer da aplicação a biblioteca passa adiante um
+ * MessageHandle para o bloco onde os fragmentos foram remontados.
+ *
+ * O pool é único no processo, para que um handle possa sobreviver à
+ * instância de ReliableCommunication que o criou.
+*/
+class MessagePool
+{
+    std::vector<Message*> free_messages;
+    std::mutex mutex;
+
+    MessagePool() = default;
+    ~MessagePool();
+
+public:
+    static MessagePool& instance();
+
+    MessagePool(const MessagePool&) = delete;
+    MessagePool& operator=(const MessagePool&) = delete;
+
+    Message* acquire();
+
+    /**
+     * Devolve o bloco ao pool. Acima de MESSAGE_POOL_ITEMS blocos livres, o
+     * bloco é liberado.
+    */
+    void release(Message* message);
+};
+
+
+/**
+ * Posse exclusiva de uma Message do MessagePool. O bloco volta ao pool
+ * quando o handle é destruído.
+*/
+class MessageHandle
+{
+    Message* message = nullptr;
+
+public:
+    MessageHandle() = default;
+    explicit MessageHandle(Message* message) : message(message) {}
+
+    static MessageHandle acquire() { return MessageHandle(MessagePool::instance().acquire()); }
+
+    MessageHandle(MessageHandle&& other) noexcept : message(std::exchange(other.message, nullptr)) {}
+
+    MessageHandle& operator=(MessageHandle&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            message = std::exchange(other.message, nullptr);
+        }
+        return *this;
+    }
+
+    MessageHandle(const MessageHandle&) = delete;
+    MessageHandle& operator=(const MessageHandle&) = delete;
+
+    ~MessageHandle() { reset(); }
+
+    void reset()
+    {
+        if (message) MessagePool::instance().release(message);
+        message = nullptr;
+    }
+
+    Message* get() const { return message; }
+    Message* operator->() const { return message; }
+    Message& operator*() const { return *message; }
+
+    explicit operator bool() const { return message != nullptr; }
+};
@@ -1,12 +1,17 @@
 #include "core/node.h"
 
-Node::Node(std::string id, SocketAddress address, bool remote)
-    : id(id), address(address), remote(remote) {};
+Node::Node(uint32_t index, std::string id, SocketAddress address, bool remote)
+    : index(index), id(id), address(address), remote(remote) {};
 
 Node::~Node()
 {
 }
 
+uint32_t Node::get_index() const
+{
+    return index;
+}
+
 const std::string &Node::get_id() const
 {
     return id;
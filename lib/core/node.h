@@ -14,14 +14,20 @@
 class Node
 {
 private:
+    uint32_t index;
     std::string id;
     SocketAddress address;
     bool remote;
 
 public:
-    Node(std::string id, SocketAddress address, bool _remote);
+    Node(uint32_t index, std::string id, SocketAddress address, bool _remote);
     ~Node();
 
+    /**
+     * Posição do nó no GroupRegistry, usada para indexar o estado por nó.
+    */
+    uint32_t get_index() const;
+
     const std::string &get_id() const;
     const SocketAddress &get_address() const;
     bool is_remote() const;
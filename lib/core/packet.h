@@ -1,5 +1,8 @@
 #pragma once
 
+#include <ostream>
+#include <sstream>
+
 #include "core/message.h"
 
 struct PacketHeader
@@ -11,7 +14,8 @@ struct PacketHeader
     unsigned int rst : 1;
     unsigned int syn : 1;
     unsigned int fin : 1;
-    unsigned int reserved: 4;
+    unsigned int wnd : 1;
+    unsigned int reserved: 3;
     unsigned int end : 1;
     unsigned int type : 4;
 
@@ -50,6 +54,15 @@ struct PacketHeader
         return (bool)fin;
     }
 
+    /**
+     * Atualização de janela: o receptor recusou o fragmento por não ter
+     * espaço para a mensagem e informa a janela atual no payload.
+    */
+    bool is_window_update() const
+    {
+        return (bool)wnd;
+    }
+
     MessageType get_message_type() const
     {
         return static_cast<MessageType>(type);
@@ -72,6 +85,13 @@ struct PacketMetadata
     SocketAddress destination = {{0, 0, 0, 0}, 0};
     int message_length = 0;
     bool expects_ack = 0;
+
+    /**
+     * Índice no GroupRegistry do nó do outro lado. Pacotes enviados já saem
+     * da conexão com o destino; o canal preenche a origem dos recebidos. As
+     * camadas usam o índice em vez de procurar o endereço.
+    */
+    uint32_t peer = UNKNOWN_PEER;
 };
 
 
@@ -81,55 +101,92 @@ enum PacketFormat {
     RECEIVED = 2
 };
 
+/**
+ * Cabeçalho e endereços de um pacote, no formato de Packet::to_string().
+ * É trivialmente copiável, então o log guarda os bytes e só monta o texto
+ * na thread de log.
+*/
+struct PacketSummary
+{
+    PacketHeader header;
+    SocketAddress origin;
+    SocketAddress destination;
+    PacketFormat format;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const PacketSummary& summary)
+{
+    const PacketHeader& header = summary.header;
+
+    const char* separator = "";
+    auto flag = [&](const char* name) {
+        os << separator << name;
+        separator = "+";
+    };
+
+    if (header.type == MessageType::APPLICATION) flag("DATA");
+    if (header.is_syn()) flag("SYN");
+    if (header.is_rst()) flag("RST");
+    if (header.is_fin()) flag("FIN");
+    if (header.is_ack()) flag("ACK");
+    if (header.is_window_update()) flag("WND");
+    if (header.is_end()) flag(*separator ? "END" : "SYN");
+
+    os << ' ' << header.msg_num << '/' << header.fragment_num;
+
+    if (summary.format == PacketFormat::RECEIVED)
+        return os << " from " << summary.origin;
+    if (summary.format == PacketFormat::SENT)
+        return os << " to " << summary.destination;
+    return os << " from " << summary.origin << " to " << summary.destination;
+}
+
 struct Packet
 {
     PacketData data;
     PacketMetadata meta;
 
+    /**
+     * ACKs e atualizações de janela carregam no payload quantas mensagens
+     * o receptor ainda tem espaço para receber.
+    */
+    static const uint32_t UNKNOWN_WINDOW = UINT32_MAX;
+
+    uint32_t get_window() const
+    {
+        if (meta.message_length < (int) sizeof(uint32_t))
+            return UNKNOWN_WINDOW;
+
+        uint32_t window;
+        memcpy(&window, data.message_data, sizeof(uint32_t));
+        return window;
+    }
+
+    void set_window(uint32_t window)
+    {
+        memcpy(data.message_data, &window, sizeof(uint32_t));
+        meta.message_length = sizeof(uint32_t);
+    }
+
+
+    /**
+     * Descrição do pacote para log, montada só quando for escrita.
+    */
+    PacketSummary summary(PacketFormat type = PacketFormat::ALL) const
+    {
+        return PacketSummary{
+            header : data.header,
+            origin : meta.origin,
+            destination : meta.destination,
+            format : type
+        };
+    }
 
     std::string to_string(PacketFormat type = PacketFormat::ALL) const
     {
-        const PacketHeader& header = data.header;
-
-        std::string flags;
-        if (header.type == MessageType::APPLICATION) flags += "DATA";
-        if (header.is_syn()) flags += flags.length() ? "+SYN" : "SYN";
-        if (header.is_rst()) flags += flags.length() ? "+RST" : "RST";
-        if (header.is_fin()) flags += flags.length() ? "+FIN" : "FIN";
-        if (header.is_ack()) flags += flags.length() ? "+ACK" : "ACK";
-        if (header.is_end()) flags += flags.length() ? "+END" : "SYN";
-
-        std::string origin = meta.origin.to_string();
-        std::string destination = meta.destination.to_string();
-
-        if (type == PacketFormat::RECEIVED) {
-            return format(
-                "%s %u/%u from %s",
-                flags.c_str(),
-                data.header.msg_num,
-                data.header.fragment_num,
-                origin.c_str()
-            );
-        }
-        
-        if (type == PacketFormat::SENT) {
-            return format(
-                "%s %u/%u to %s",
-                flags.c_str(),
-                data.header.msg_num,
-                data.header.fragment_num,
-                destination.c_str()
-            );
-        }
-
-        return format(
-            "%s %u/%u from %s to %s",
-            flags.c_str(),
-            data.header.msg_num,
-            data.header.fragment_num,
-            origin.c_str(),
-            destination.c_str()
-        );
+        std::ostringstream oss;
+        oss << summary(type);
+        return oss.str();
     }
 
     bool operator==(const Packet &other) const
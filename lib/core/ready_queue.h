@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "utils/log.h"
+
+/**
+ * Gancho que um objeto precisa ter para entrar em uma ReadyQueue.
+*/
+template <typename T>
+struct ReadyHook {
+    enum State : uint8_t {
+        IDLE = 0,
+        SCHEDULED = 1,
+        RUNNING = 2,
+        /**
+         * Agendado de novo enquanto era processado.
+        */
+        RUNNING_DIRTY = 3
+    };
+
+    std::atomic<uint8_t> state{IDLE};
+    T* next = nullptr;
+};
+
+
+/**
+ * Fila FIFO intrusiva de objetos com trabalho pendente. Cada objeto entra
+ * no máximo uma vez: agendar um objeto que já está na fila não faz nada, e
+ * isso é decidido pelo estado atômico do gancho, sem tocar no lock. Os
+ * objetos são encadeados pelo próprio gancho, então agendar não aloca
+ * memória.
+ *
+ * Um objeto consumido fica em RUNNING até finish(). Pedidos feitos nesse
+ * intervalo só o marcam, e finish() o devolve à fila, então um mesmo objeto
+ * nunca é processado por duas threads ao mesmo tempo, mesmo que várias
+ * consumam de várias filas.
+*/
+template <typename T, ReadyHook<T> T::*hook>
+class ReadyQueue
+{
+    using Hook = ReadyHook<T>;
+
+    std::string name;
+
+    T* head = nullptr;
+    T* tail = nullptr;
+
+    std::mutex mutex;
+
+    void push(T* item)
+    {
+        mutex.lock();
+
+        (item->*hook).next = nullptr;
+        if (tail) (tail->*hook).next = item;
+        else head = item;
+        tail = item;
+
+        log_trace("Scheduled item on [", name, "] queue.");
+
+        mutex.unlock();
+    }
+
+public:
+    ReadyQueue(std::string name) : name(name) {};
+
+    /**
+     * Agenda `item`. Retorna true se ele entrou na fila agora, e false se
+     * já estava nela ou está sendo processado (nesse caso será devolvido à
+     * fila por finish()).
+    */
+    bool schedule(T* item)
+    {
+        std::atomic<uint8_t>& state = (item->*hook).state;
+        uint8_t current = state.load(std::memory_order_acquire);
+
+        while (true)
+        {
+            if (current == Hook::IDLE)
+            {
+                if (state.compare_exchange_weak(current, Hook::SCHEDULED, std::memory_order_acq_rel)) break;
+            }
+            else if (current == Hook::RUNNING)
+            {
+                if (state.compare_exchange_weak(current, Hook::RUNNING_DIRTY, std::memory_order_acq_rel)) return false;
+            }
+            else return false;
+        }
+
+        push(item);
+        return true;
+    }
+
+    /**
+     * Retira o próximo objeto sem bloquear, ou nullptr se a fila estiver
+     * vazia. O objeto passa a RUNNING até finish().
+    */
+    T* try_consume()
+    {
+        mutex.lock();
+
+        T* item = head;
+        if (item)
+        {
+            head = (item->*hook).next;
+            if (!head) tail = nullptr;
+            (item->*hook).next = nullptr;
+        }
+
+        mutex.unlock();
+
+        if (item) (item->*hook).state.store(Hook::RUNNING, std::memory_order_release);
+
+        return item;
+    }
+
+    /**
+     * Retira `item` da fila se ele estiver esperando nela. Retorna true se
+     * ele não está mais na fila nem sendo processado, e false se ainda está
+     * (por exemplo, em RUNNING); quem vai destruí-lo tenta de novo.
+    */
+    bool cancel(T* item)
+    {
+        std::atomic<uint8_t>& state = (item->*hook).state;
+        if (state.load(std::memory_order_acquire) == Hook::IDLE) return true;
+
+        mutex.lock();
+
+        T* previous = nullptr;
+        for (T* current = head; current; current = (current->*hook).next)
+        {
+            if (current != item)
+            {
+                previous = current;
+                continue;
+            }
+
+            T* next = (item->*hook).next;
+            if (previous) (previous->*hook).next = next;
+            else head = next;
+            if (tail == item) tail = previous;
+            (item->*hook).next = nullptr;
+
+            state.store(Hook::IDLE, std::memory_order_release);
+
+            mutex.unlock();
+            return true;
+        }
+
+        mutex.unlock();
+        return false;
+    }
+
+    /**
+     * Encerra o processamento de `item`. Se ele foi agendado durante o
+     * processamento, volta para esta fila e o retorno é true.
+    */
+    bool finish(T* item)
+    {
+        std::atomic<uint8_t>& state = (item->*hook).state;
+        uint8_t running = Hook::RUNNING;
+
+        if (state.compare_exchange_strong(running, Hook::IDLE, std::memory_order_acq_rel)) return false;
+
+        state.store(Hook::SCHEDULED, std::memory_order_release);
+        push(item);
+        return true;
+    }
+};
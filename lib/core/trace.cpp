@@ -0,0 +1,125 @@
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "core/trace.h"
+#include "utils/log.h"
+
+std::atomic<TraceHeader*> Trace::active{nullptr};
+
+bool Trace::open(const std::string& path, uint64_t capacity)
+{
+    if (!capacity)
+        return false;
+
+    std::size_t size = sizeof(TraceHeader) + capacity * sizeof(TraceRecord);
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        log_error("Unable to create trace file ", path, ": ", strerror(errno), ".");
+        return false;
+    }
+
+    if (ftruncate(fd, size) < 0)
+    {
+        log_error("Unable to resize trace file ", path, ": ", strerror(errno), ".");
+        ::close(fd);
+        return false;
+    }
+
+    void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (region == MAP_FAILED)
+    {
+        log_error("Unable to map trace file ", path, ": ", strerror(errno), ".");
+        return false;
+    }
+
+    // O arquivo recém-truncado é zerado, então os registros já começam vazios.
+    TraceHeader* header = new (region) TraceHeader;
+    memcpy(header->magic, TraceHeader::MAGIC, sizeof(header->magic));
+    header->version = TraceHeader::VERSION;
+    header->record_size = sizeof(TraceRecord);
+    header->capacity = capacity;
+    header->next.store(0, std::memory_order_relaxed);
+
+    close();
+    active.store(header, std::memory_order_release);
+
+    log_info("Tracing packets to ", path, " (", capacity, " records).");
+    return true;
+}
+
+void Trace::close()
+{
+    TraceHeader* header = active.exchange(nullptr);
+    if (!header)
+        return;
+
+    msync(header, sizeof(TraceHeader) + header->capacity * sizeof(TraceRecord), MS_ASYNC);
+}
+
+void Trace::record(TraceEvent event, uint32_t peer, uint32_t msg_num, uint32_t frag_num, uint16_t flags, uint32_t length)
+{
+    TraceHeader* header = active.load(std::memory_order_acquire);
+    if (!header)
+        return;
+
+    uint64_t position = header->next.fetch_add(1, std::memory_order_relaxed);
+    TraceRecord* records = reinterpret_cast<TraceRecord*>(header + 1);
+
+    uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+
+    records[position % header->capacity] = TraceRecord{
+        timestamp : now,
+        thread : (uint32_t) get_thread_id(),
+        event : (uint16_t) event,
+        flags : flags,
+        peer : peer,
+        msg_num : msg_num,
+        frag_num : frag_num,
+        length : length
+    };
+}
+
+const char* Trace::event_name(uint16_t event)
+{
+    switch ((TraceEvent) event)
+    {
+        case TraceEvent::PACKET_SENT: return "SENT";
+        case TraceEvent::PACKET_RECEIVED: return "RECEIVED";
+        case TraceEvent::PACKET_LOST: return "LOST";
+        case TraceEvent::PACKET_RETRANSMITTED: return "RETRANSMITTED";
+        case TraceEvent::PACKET_EXPIRED: return "EXPIRED";
+        case TraceEvent::CHECKSUM_MISMATCH: return "CHECKSUM_MISMATCH";
+        case TraceEvent::MESSAGE_DELIVERED: return "DELIVERED";
+    }
+    return "UNKNOWN";
+}
+
+std::string Trace::describe_flags(uint16_t flags)
+{
+    static const char* const NAMES[] = {"ACK", "RST", "SYN", "FIN", "WND", "END"};
+
+    std::string result;
+    if (((flags >> 8) & 0xF) == MessageType::APPLICATION)
+        result = "DATA";
+
+    // Mesma ordem de Packet::to_string().
+    for (int bit : {2, 1, 3, 0, 4, 5})
+    {
+        if (!(flags & (1 << bit)))
+            continue;
+        if (result.size())
+            result += '+';
+        result += NAMES[bit];
+    }
+    return result;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "core/constants.h"
+#include "core/packet.h"
+
+/**
+ * Eventos do caminho dos pacotes registrados no trace binário.
+*/
+enum class TraceEvent : uint16_t
+{
+    PACKET_SENT = 1,
+    PACKET_RECEIVED = 2,
+    /**
+     * Perdido pela injeção de falhas ou pela fila do enlace simulado.
+    */
+    PACKET_LOST = 3,
+    PACKET_RETRANSMITTED = 4,
+    /**
+     * O pacote esgotou as tentativas e a transmissão falhou.
+    */
+    PACKET_EXPIRED = 5,
+    CHECKSUM_MISMATCH = 6,
+    MESSAGE_DELIVERED = 7,
+};
+
+/**
+ * Registro de tamanho fixo do trace. `flags` guarda as flags do cabeçalho
+ * do pacote (Trace::pack_flags) e `length` o tamanho do payload.
+*/
+struct TraceRecord
+{
+    /**
+     * Nanossegundos desde a época (relógio de parede), 0 em posições ainda
+     * não escritas.
+    */
+    uint64_t timestamp;
+    uint32_t thread;
+    uint16_t event;
+    uint16_t flags;
+    uint32_t peer;
+    uint32_t msg_num;
+    uint32_t frag_num;
+    uint32_t length;
+};
+
+static_assert(sizeof(TraceRecord) == 32);
+
+/**
+ * Início do arquivo de trace, seguido de `capacity` registros. O arquivo é
+ * um anel: o registro n fica na posição n % capacity, e `next` é o número
+ * do próximo registro.
+*/
+struct TraceHeader
+{
+    static constexpr char MAGIC[8] = {'R', 'C', 'T', 'R', 'A', 'C', 'E', '1'};
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;
+    std::atomic<uint64_t> next;
+    char reserved[32];
+};
+
+static_assert(sizeof(TraceHeader) == 64);
+
+/**
+ * Trace binário do caminho dos pacotes, escrito em um arquivo mapeado em
+ * memória. Com o trace aberto, os eventos de pacote deixam de gerar linhas
+ * de texto no log: cada um vira um TraceRecord de 32 bytes, escrito com um
+ * único incremento atômico, sem lock, alocação ou formatação. O arquivo é
+ * lido depois pelo trace_decoder (tools/trace_decoder.cpp).
+ *
+ * O trace é único no processo, como o log.
+*/
+class Trace
+{
+    static std::atomic<TraceHeader*> active;
+
+public:
+    /**
+     * Cria (ou trunca) o arquivo em `path` com espaço para `capacity`
+     * registros e passa a registrar nele. Retorna false se o arquivo não
+     * pôde ser criado.
+    */
+    static bool open(const std::string& path, uint64_t capacity = TRACE_RECORDS);
+
+    /**
+     * Para de registrar e sincroniza o arquivo. O mapeamento não é desfeito,
+     * porque outra thread pode estar escrevendo o último registro.
+    */
+    static void close();
+
+    static bool enabled()
+    {
+        return active.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    static void record(TraceEvent event, uint32_t peer, uint32_t msg_num, uint32_t frag_num, uint16_t flags, uint32_t length);
+
+    static void record(TraceEvent event, const Packet& packet)
+    {
+        const PacketHeader& header = packet.data.header;
+        record(event, packet.meta.peer, header.msg_num, header.fragment_num, pack_flags(header), packet.meta.message_length);
+    }
+
+    /**
+     * Bits 0-5: ACK, RST, SYN, FIN, WND e END; bits 8-11: tipo da mensagem.
+    */
+    static uint16_t pack_flags(const PacketHeader& header)
+    {
+        return header.ack | (header.rst << 1) | (header.syn << 2) | (header.fin << 3)
+            | (header.wnd << 4) | (header.end << 5) | (header.type << 8);
+    }
+
+    static const char* event_name(uint16_t event);
+
+    /**
+     * Flags legíveis, ex.: "DATA+END".
+    */
+    static std::string describe_flags(uint16_t flags);
+};
@@ -1,30 +1,46 @@
 #include <thread>
 
 #include "pipeline/channel/channel_layer.h"
+#include "pipeline/protocol_stack.h"
+#include "core/event.h"
 #include "utils/log.h"
 
-ChannelLayer::ChannelLayer(PipelineHandler handler, SocketAddress local_address) : PipelineStep(handler, nullptr)
+template <typename Handler>
+ChannelLayer<Handler>::ChannelLayer(Handler handler, GroupRegistry *gr, SocketAddress local_address)
+    : PipelineLayer<Handler>(handler, gr)
 {
     channel = std::make_unique<Channel>(local_address);
     receiver_thread = std::thread([this]()
                                   { receiver(); });
 }
 
-ChannelLayer::~ChannelLayer()
+template <typename Handler>
+ChannelLayer<Handler>::~ChannelLayer()
 {
     channel->shutdown_socket();
     receiver_thread.join();
 }
 
-void ChannelLayer::receiver()
+template <typename Handler>
+void ChannelLayer<Handler>::receiver()
 {
     log_info("Initialized receiver thread.");
     while (true)
     {
         try
         {
-            Packet packet = channel->receive();
-            receive(packet);
+            std::span<Packet> packets = channel->receive_many();
+            bool batch = packets.size() > 1;
+
+            if (batch) handler.notify(ReceiveBatchStarted());
+
+            for (Packet& packet : packets)
+            {
+                Counters::LayerScope scope = handler.measure(true);
+                receive(packet);
+            }
+
+            if (batch) handler.notify(ReceiveBatchFinished());
         }
         catch (const std::runtime_error &e)
         {
@@ -34,12 +50,26 @@ void ChannelLayer::receiver()
     log_info("Closed receiver thread.");
 }
 
-void ChannelLayer::send(Packet packet)
+template <typename Handler>
+void ChannelLayer<Handler>::send(Packet packet)
 {
-    channel->send(packet);
+    if (!channel->send(packet))
+        return;
+
+    handler.count(packet.meta.peer, Counter::PACKETS_SENT);
+    handler.count(packet.meta.peer, Counter::BYTES_SENT, sizeof(PacketHeader) + packet.meta.message_length);
 }
 
-void ChannelLayer::receive(Packet packet)
+template <typename Handler>
+void ChannelLayer<Handler>::receive(Packet packet)
 {
+    packet.meta.peer = gr->find_peer(packet.meta.origin);
+
+    handler.count(packet.meta.peer, Counter::PACKETS_RECEIVED);
+    handler.count(packet.meta.peer, Counter::BYTES_RECEIVED, sizeof(PacketHeader) + packet.meta.message_length);
+
     handler.forward_receive(packet);
-}
\ No newline at end of file
+}
+
+template class ChannelLayer<PipelineHandler>;
+template class ChannelLayer<ProtocolHandler<Pipeline::CHANNEL_LAYER>>;
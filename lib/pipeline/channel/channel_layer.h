@@ -1,3 +1,5 @@
+#pragma once
+
 #include <thread>
 
 #include "channels/channel.h"
@@ -6,13 +8,17 @@
 #include "utils/date.h"
 #include "utils/log.h"
 
-class ChannelLayer : public PipelineStep {
+template <typename Handler>
+class ChannelLayer : public PipelineLayer<Handler> {
+    using PipelineLayer<Handler>::handler;
+    using PipelineLayer<Handler>::gr;
+
     std::unique_ptr<Channel> channel;
     std::thread receiver_thread;
 
     void receiver();
 public:
-    ChannelLayer(PipelineHandler handler, SocketAddress local_address);
+    ChannelLayer(Handler handler, GroupRegistry *gr, SocketAddress local_address);
 
     ~ChannelLayer();
 
@@ -1,13 +1,18 @@
 #include "pipeline/checksum/checksum_layer.h"
+#include "pipeline/protocol_stack.h"
+#include "core/trace.h"
 #include "utils/log.h"
 
-ChecksumLayer::ChecksumLayer(PipelineHandler handler) : PipelineStep(handler, nullptr) {}
+template <typename Handler>
+ChecksumLayer<Handler>::ChecksumLayer(Handler handler) : PipelineLayer<Handler>(handler, nullptr) {}
 
-ChecksumLayer::~ChecksumLayer() {}
+template <typename Handler>
+ChecksumLayer<Handler>::~ChecksumLayer() {}
 
-void ChecksumLayer::send(Packet packet)
+template <typename Handler>
+void ChecksumLayer<Handler>::send(Packet packet)
 {
-    log_trace("Packet ", packet.to_string(PacketFormat::SENT), " sent to checksum layer.");
+    log_trace("Packet ", packet.summary(PacketFormat::SENT), " sent to checksum layer.");
 
     PacketData &data = packet.data;
 
@@ -21,9 +26,10 @@ void ChecksumLayer::send(Packet packet)
     handler.forward_send(packet);
 }
 
-void ChecksumLayer::receive(Packet packet)
+template <typename Handler>
+void ChecksumLayer<Handler>::receive(Packet packet)
 {
-    log_trace("Packet ", packet.to_string(PacketFormat::RECEIVED), " received on checksum layer.");
+    log_trace("Packet ", packet.summary(PacketFormat::RECEIVED), " received on checksum layer.");
 
     unsigned short received_checksum = packet.data.header.checksum;
     PacketData &data = packet.data;
@@ -39,12 +45,18 @@ void ChecksumLayer::receive(Packet packet)
     }
     else {
         log_warn("Checksum is different: Expected ", received_checksum, ", got ", calculated_checksum);
+        Trace::record(TraceEvent::CHECKSUM_MISMATCH, packet);
+        handler.count(packet.meta.peer, Counter::CHECKSUM_FAILURES);
     }
 }
 
-void ChecksumLayer::prepare_packet_buffer(const PacketData &packet_data, std::size_t message_length, char *buffer)
+template <typename Handler>
+void ChecksumLayer<Handler>::prepare_packet_buffer(const PacketData &packet_data, std::size_t message_length, char *buffer)
 {
     memset(buffer, 0, PacketData::MAX_PACKET_SIZE);
     memcpy(buffer, &packet_data.header, sizeof(PacketHeader));
     memcpy(buffer + sizeof(PacketHeader), packet_data.message_data, message_length);
-}
\ No newline at end of file
+}
+
+template class ChecksumLayer<PipelineHandler>;
+template class ChecksumLayer<ProtocolHandler<Pipeline::CHECKSUM_LAYER>>;
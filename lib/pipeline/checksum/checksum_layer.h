@@ -1,3 +1,5 @@
+#pragma once
+
 #include <thread>
 
 #include "pipeline/pipeline_step.h"
@@ -5,10 +7,13 @@
 #include "utils/date.h"
 #include "crc16.h"
 
-class ChecksumLayer : public PipelineStep
+template <typename Handler>
+class ChecksumLayer : public PipelineLayer<Handler>
 {
+    using PipelineLayer<Handler>::handler;
+
 public:
-    ChecksumLayer(PipelineHandler handler);
+    ChecksumLayer(Handler handler);
 
     ~ChecksumLayer();
 
@@ -1,6 +1,8 @@
 #include <random>
 
 #include "pipeline/fault_injection/fault_injection_layer.h"
+#include "pipeline/protocol_stack.h"
+#include "core/trace.h"
 #include "utils/log.h"
 
 bool roll_chance(double chance) {
@@ -8,23 +10,63 @@ bool roll_chance(double chance) {
     return value < chance;
 }
 
-FaultInjectionLayer::FaultInjectionLayer(PipelineHandler handler) : FaultInjectionLayer(handler, 0, 0, 0) {}
-FaultInjectionLayer::FaultInjectionLayer(
-    PipelineHandler handler, int min_delay, int max_delay, double lose_chance
+template <typename Handler>
+FaultInjectionLayer<Handler>::FaultInjectionLayer(Handler handler) : FaultInjectionLayer(handler, 0, 0, 0) {}
+template <typename Handler>
+FaultInjectionLayer<Handler>::FaultInjectionLayer(
+    Handler handler, int min_delay, int max_delay, double lose_chance
 ) :
-    PipelineStep(handler, nullptr),
+    PipelineLayer<Handler>(handler, nullptr),
     min_delay(min_delay),
     max_delay(max_delay),
     lose_chance(lose_chance)
-    {}
+{
+    delivery_thread = std::thread([this]() { delivery_routine(); });
+}
+
+template <typename Handler>
+FaultInjectionLayer<Handler>::~FaultInjectionLayer() {
+    mutex_delayed.lock();
+    stop = true;
+    mutex_delayed.unlock();
+    has_delayed.notify_one();
+
+    delivery_thread.join();
+}
+
+template <typename Handler>
+void FaultInjectionLayer<Handler>::delivery_routine() {
+    std::unique_lock lock(mutex_delayed);
+
+    while (!stop) {
+        if (delayed.empty()) {
+            has_delayed.wait(lock);
+            continue;
+        }
+
+        if (std::chrono::steady_clock::now() < delayed.top().due) {
+            has_delayed.wait_until(lock, delayed.top().due);
+            continue;
+        }
+
+        Packet packet = delayed.top().packet;
+        delayed.pop();
 
-void FaultInjectionLayer::enqueue_fault(int delay = INT_MAX) {
+        lock.unlock();
+        proceed_receive(packet);
+        lock.lock();
+    }
+}
+
+template <typename Handler>
+void FaultInjectionLayer<Handler>::enqueue_fault(int delay) {
     mutex_fault_queue.lock();
     fault_queue.push_back(delay);
     mutex_fault_queue.unlock();
 }
 
-void FaultInjectionLayer::enqueue_fault(const std::vector<int>& faults) {
+template <typename Handler>
+void FaultInjectionLayer<Handler>::enqueue_fault(const std::vector<int>& faults) {
     mutex_fault_queue.lock();
     for (const int delay : faults) {
         fault_queue.push_back(delay);
@@ -32,7 +74,35 @@ void FaultInjectionLayer::enqueue_fault(const std::vector<int>& faults) {
     mutex_fault_queue.unlock();
 }
 
-void FaultInjectionLayer::receive(Packet packet) {
+template <typename Handler>
+void FaultInjectionLayer<Handler>::limit_bandwidth(int bandwidth, int link_queue_size) {
+    this->bandwidth = bandwidth;
+    this->link_queue_size = link_queue_size;
+}
+
+/**
+ * Simula a passagem do pacote por um enlace com capacidade `bandwidth` e uma
+ * fila finita. Retorna o atraso em ms até o pacote terminar de atravessar o
+ * enlace, ou -1 se a fila estiver cheia e o pacote deve ser descartado.
+*/
+template <typename Handler>
+int FaultInjectionLayer<Handler>::enter_link(const Packet& packet) {
+    uint64_t now = DateUtils::monotonic_us();
+    uint64_t start = std::max(now, link_free_at);
+
+    uint64_t size = sizeof(PacketHeader) + packet.meta.message_length;
+    uint64_t queued_bytes = (start - now) * bandwidth / 1000000;
+    uint64_t max_queued_bytes = (uint64_t) link_queue_size * PacketData::MAX_PACKET_SIZE;
+
+    if (queued_bytes + size > max_queued_bytes) return -1;
+
+    link_free_at = start + size * 1000000 / bandwidth;
+
+    return (link_free_at - now + 999) / 1000;
+}
+
+template <typename Handler>
+void FaultInjectionLayer<Handler>::receive(Packet packet) {
     int delay = -1;
 
     if (fault_queue.size()) {
@@ -46,7 +116,12 @@ void FaultInjectionLayer::receive(Packet packet) {
 
     // lose packet entirely
     if (delay == INT_MAX || (delay == -1 && roll_chance(lose_chance))) {
-        log_warn("Lost ", packet.to_string(PacketFormat::RECEIVED));
+        if (Trace::enabled()) {
+            Trace::record(TraceEvent::PACKET_LOST, packet);
+        }
+        else {
+            log_warn("Lost ", packet.summary(PacketFormat::RECEIVED));
+        }
         return;
     };
 
@@ -67,17 +142,51 @@ void FaultInjectionLayer::receive(Packet packet) {
         );
     }
 
+    if (bandwidth) {
+        int link_delay = enter_link(packet);
+
+        if (link_delay < 0) {
+            if (Trace::enabled()) {
+                Trace::record(TraceEvent::PACKET_LOST, packet);
+            }
+            else {
+                log_warn("Lost ", packet.summary(PacketFormat::RECEIVED), ", simulated link queue is full.");
+            }
+            return;
+        }
+
+        delay = std::max(delay, 0) + link_delay;
+    }
+
     if (delay > 0) {
-        timer.add(delay, [this, packet]() {
-            proceed_receive(packet);
+        std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+
+        mutex_delayed.lock();
+        bool earliest = delayed.empty() || due < delayed.top().due;
+        delayed.push(DelayedPacket{
+            .due = due,
+            .seq = delayed_seq++,
+            .packet = packet,
         });
+        mutex_delayed.unlock();
+
+        if (earliest) has_delayed.notify_one();
     }
     else {
         proceed_receive(packet);
     }
 }
 
-void FaultInjectionLayer::proceed_receive(Packet packet) {
-    log_info("Received ", packet.to_string(PacketFormat::RECEIVED), " (", packet.meta.message_length, " bytes).");
+template <typename Handler>
+void FaultInjectionLayer<Handler>::proceed_receive(Packet packet) {
+    if (Trace::enabled()) {
+        Trace::record(TraceEvent::PACKET_RECEIVED, packet);
+    }
+    else {
+        log_info("Received ", packet.summary(PacketFormat::RECEIVED), " (", packet.meta.message_length, " bytes).");
+    }
     handler.forward_receive(packet);
-}
\ No newline at end of file
+}
+
+template class FaultInjectionLayer<PipelineHandler>;
+template class FaultInjectionLayer<ProtocolHandler<Pipeline::FAULT_INJECTION_LAYER>>;
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <chrono>
+#include <climits>
+#include <condition_variable>
 #include <mutex>
+#include <queue>
+#include <thread>
 
 #include "pipeline/pipeline_step.h"
 #include "core/packet.h"
@@ -8,23 +13,76 @@
 
 struct FaultConfig {
     std::vector<int> faults;
+    int min_delay = 200;
+    int max_delay = 500;
+    /**
+     * Capacidade em bytes/s do enlace simulado na recepção. 0 desativa o limite.
+    */
+    int bandwidth = 0;
+    /**
+     * Quantos pacotes de tamanho máximo cabem na fila do enlace simulado antes
+     * que pacotes passem a ser descartados.
+    */
+    int link_queue_size = 16;
 };
 
-class FaultInjectionLayer : public PipelineStep {
-    Timer timer;
+/**
+ * Pacote atrasado, entregue às camadas de cima quando `due` chegar.
+*/
+struct DelayedPacket {
+    std::chrono::steady_clock::time_point due;
+    uint64_t seq;
+    Packet packet;
+
+    /**
+     * Ordem inversa, para que a std::priority_queue entregue primeiro o que
+     * vence antes, e na ordem de chegada quando empatam.
+    */
+    bool operator<(const DelayedPacket& other) const
+    {
+        return due != other.due ? due > other.due : seq > other.seq;
+    }
+};
+
+template <typename Handler>
+class FaultInjectionLayer : public PipelineLayer<Handler> {
+    using PipelineLayer<Handler>::handler;
+
+    /**
+     * Pacotes atrasados e a thread que os entrega. A entrega percorre o resto
+     * da recepção (checksum, remontagem, conexão) e pode bloquear no buffer
+     * da aplicação, por isso não roda na thread do TimerService.
+    */
+    std::priority_queue<DelayedPacket> delayed;
+    uint64_t delayed_seq = 0;
+    std::mutex mutex_delayed;
+    std::condition_variable has_delayed;
+    bool stop = false;
+    std::thread delivery_thread;
+
+    void delivery_routine();
     std::vector<int> fault_queue;
     std::mutex mutex_fault_queue;
     
     int min_delay;
     int max_delay;
     double lose_chance;
+
+    int bandwidth = 0;
+    int link_queue_size = 0;
+    uint64_t link_free_at = 0;
+
+    int enter_link(const Packet& packet);
 public:
-    FaultInjectionLayer(PipelineHandler handler);
-    FaultInjectionLayer(PipelineHandler handler, int min_delay, int max_delay, double lose_chance);
+    FaultInjectionLayer(Handler handler);
+    FaultInjectionLayer(Handler handler, int min_delay, int max_delay, double lose_chance);
+    ~FaultInjectionLayer();
 
-    void enqueue_fault(int delay);
+    void enqueue_fault(int delay = INT_MAX);
     void enqueue_fault(const std::vector<int>& faults);
 
+    void limit_bandwidth(int bandwidth, int link_queue_size);
+
     void receive(Packet packet);
 
     void proceed_receive(Packet packet);
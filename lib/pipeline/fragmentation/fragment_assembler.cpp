@@ -1,6 +1,6 @@
 #include "pipeline/fragmentation/fragment_assembler.h"
 
-FragmentAssembler::FragmentAssembler() : bytes_received(0), last_fragment_number(INT_MAX), received_fragments()
+FragmentAssembler::FragmentAssembler() : bytes_received(0), last_fragment_number(INT_MAX), received_fragments(), message(MessageHandle::acquire())
 {
 }
 
@@ -18,12 +18,12 @@ bool FragmentAssembler::is_complete()
     return last_fragment_number == received_fragments.size() - 1;
 }
 
-void FragmentAssembler::add_packet(Packet &packet)
+bool FragmentAssembler::add_packet(Packet &packet)
 {
     if (has_received(packet))
     {
-        log_trace("Ignoring duplicated ", packet.to_string(PacketFormat::RECEIVED), ".");
-        return;
+        log_trace("Ignoring duplicated ", packet.summary(PacketFormat::RECEIVED), ".");
+        return false;
     };
 
     PacketMetadata& meta = packet.meta;
@@ -34,23 +34,25 @@ void FragmentAssembler::add_packet(Packet &packet)
 
     unsigned int pos_in_msg = fragment_number * PacketData::MAX_MESSAGE_SIZE;
     unsigned int len = meta.message_length;
-    memcpy(&message.data[pos_in_msg], packet.data.message_data, len);
+    memcpy(&message->data[pos_in_msg], packet.data.message_data, len);
     bytes_received += len;
 
-    message.number = header.get_message_number();
-    message.type = header.get_message_type();
-    message.origin = meta.origin;
-    message.destination = meta.destination;
+    message->number = header.get_message_number();
+    message->type = header.get_message_type();
+    message->origin = meta.origin;
+    message->destination = meta.destination;
+    message->peer = meta.peer;
 
     if (header.is_end())
     {
-        log_trace("Packet ", packet.to_string(PacketFormat::RECEIVED), " is the last one of its message.");
+        log_trace("Packet ", packet.summary(PacketFormat::RECEIVED), " is the last one of its message.");
         last_fragment_number = fragment_number;
     }
+    return true;
 }
 
-Message &FragmentAssembler::assemble()
+MessageHandle FragmentAssembler::assemble()
 {
-    message.length = bytes_received;
-    return message;
+    message->length = bytes_received;
+    return std::move(message);
 }
\ No newline at end of file
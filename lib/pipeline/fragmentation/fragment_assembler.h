@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "core/message.h"
+#include "core/message_pool.h"
 #include "core/packet.h"
 #include "utils/log.h"
 
@@ -12,7 +13,7 @@ class FragmentAssembler
     unsigned int bytes_received;
     uint32_t last_fragment_number;
     std::unordered_set<uint32_t> received_fragments;
-    Message message{};
+    MessageHandle message;
 
 public:
     FragmentAssembler();
@@ -20,6 +21,14 @@ public:
 
     bool has_received(Packet&);
     bool is_complete();
-    void add_packet(Packet&);
-    Message &assemble();
+    /**
+     * Retorna false se o fragmento já havia sido recebido.
+    */
+    bool add_packet(Packet&);
+
+    /**
+     * Entrega o bloco onde a mensagem foi remontada. O assembler não deve
+     * ser usado depois.
+    */
+    MessageHandle assemble();
 };
\ No newline at end of file
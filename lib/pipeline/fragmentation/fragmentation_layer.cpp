@@ -1,14 +1,18 @@
 #include "pipeline/fragmentation/fragmentation_layer.h"
+#include "pipeline/protocol_stack.h"
 #include <cmath>
 
-FragmentationLayer::FragmentationLayer(PipelineHandler handler, GroupRegistry *gr)
-    : PipelineStep(handler, gr)
+template <typename Handler>
+FragmentationLayer<Handler>::FragmentationLayer(Handler handler, GroupRegistry *gr)
+    : PipelineLayer<Handler>(handler, gr)
 {
 }
 
-FragmentationLayer::~FragmentationLayer() = default;
+template <typename Handler>
+FragmentationLayer<Handler>::~FragmentationLayer() = default;
 
-void FragmentationLayer::send(Message message)
+template <typename Handler>
+void FragmentationLayer<Handler>::send(Message message)
 {
     Fragmenter fragmenter(message);
 
@@ -18,53 +22,95 @@ void FragmentationLayer::send(Message message)
     while (fragmenter.has_next())
     {
         fragmenter.next(&packet);
-        log_trace("Forwarding ", packet.to_string(PacketFormat::SENT), " to next step.");
+        log_trace("Forwarding ", packet.summary(PacketFormat::SENT), " to next step.");
         handler.forward_send(packet);
     }
 }
 
-void FragmentationLayer::send(Packet packet)
+template <typename Handler>
+void FragmentationLayer<Handler>::send(Packet packet)
 {
-    log_trace("Packet [", packet.to_string(PacketFormat::SENT), "] sent to fragmentation layer.");
+    log_trace("Packet [", packet.summary(PacketFormat::SENT), "] sent to fragmentation layer.");
     handler.forward_send(packet);
 }
 
-void FragmentationLayer::receive(Packet packet)
+template <typename Handler>
+void FragmentationLayer<Handler>::receive(Packet packet)
 {
-    log_trace("Packet [", packet.to_string(PacketFormat::RECEIVED), "] received on fragmentation layer.");
+    log_trace("Packet [", packet.summary(PacketFormat::RECEIVED), "] received on fragmentation layer.");
     handler.forward_receive(packet);
 
     if (packet.data.header.get_message_type() != MessageType::APPLICATION)
         return;
 
-    std::string message_id = get_message_identifier(packet);
+    uint32_t message_number = packet.data.header.get_message_number();
 
-    if (!assembler_map.contains(message_id))
-        assembler_map.emplace(message_id, FragmentAssembler());
+    mutex_assemblers.lock();
+    FragmentAssembler &assembler = get_assemblers(packet.meta.peer).try_emplace(message_number).first->second;
+    bool added = assembler.add_packet(packet);
+    bool complete = assembler.is_complete();
+    mutex_assemblers.unlock();
 
-    FragmentAssembler &assembler = assembler_map.at(message_id);
-    assembler.add_packet(packet);
+    if (!added)
+        handler.count(packet.meta.peer, Counter::DUPLICATE_FRAGMENTS);
 
-    if (!assembler.is_complete())
+    if (!complete)
         return;
 
     log_debug("Received all fragments; notifying connection.");
     handler.notify(MessageDefragmentationIsComplete(packet));
 }
 
-void FragmentationLayer::attach(EventBus &bus)
+template <typename Handler>
+void FragmentationLayer<Handler>::attach(EventBus &bus)
 {
     obs_forward_defragmented_message.on(std::bind(&FragmentationLayer::forward_defragmented_message, this, _1));
     bus.attach(obs_forward_defragmented_message);
+    obs_peer_removed.on(std::bind(&FragmentationLayer::peer_removed, this, _1));
+    bus.attach(obs_peer_removed);
+    obs_peer_idle.on(std::bind(&FragmentationLayer::peer_idle, this, _1));
+    bus.attach(obs_peer_idle);
 }
 
-void FragmentationLayer::forward_defragmented_message(const ForwardDefragmentedMessage &event)
+template <typename Handler>
+void FragmentationLayer<Handler>::peer_removed(const PeerRemoved &event)
+{
+    mutex_assemblers.lock();
+    if (event.peer < assemblers.size())
+        assemblers[event.peer].clear();
+    mutex_assemblers.unlock();
+}
+
+template <typename Handler>
+void FragmentationLayer<Handler>::peer_idle(const PeerIdle &event)
+{
+    mutex_assemblers.lock();
+    // clear() mantém a tabela de buckets alocada; a troca a libera.
+    if (event.peer < assemblers.size() && assemblers[event.peer].empty())
+        std::unordered_map<uint32_t, FragmentAssembler>().swap(assemblers[event.peer]);
+    mutex_assemblers.unlock();
+}
+
+template <typename Handler>
+void FragmentationLayer<Handler>::forward_defragmented_message(const ForwardDefragmentedMessage &event)
 {
     Packet &packet = event.packet;
-    std::string message_id = get_message_identifier(packet);
+    uint32_t message_number = packet.data.header.get_message_number();
 
-    Message const message = assembler_map.at(message_id).assemble();
-    assembler_map.erase(message_id);
+    mutex_assemblers.lock();
+    std::unordered_map<uint32_t, FragmentAssembler>& peer_assemblers = get_assemblers(packet.meta.peer);
+    auto assembler = peer_assemblers.find(message_number);
+    if (assembler == peer_assemblers.end())
+    {
+        mutex_assemblers.unlock();
+        return;
+    }
+    MessageHandle message = assembler->second.assemble();
+    peer_assemblers.erase(assembler);
+    mutex_assemblers.unlock();
+
+    handler.forward_receive(std::move(message));
+}
 
-    handler.forward_receive(message);
-}
\ No newline at end of file
+template class FragmentationLayer<PipelineHandler>;
+template class FragmentationLayer<ProtocolHandler<Pipeline::FRAGMENTATION_LAYER>>;
@@ -1,32 +1,48 @@
 #pragma once
 
-#include <map>
+#include <unordered_map>
+#include <vector>
 #include <mutex>
 
 #include "pipeline/fragmentation/fragment_assembler.h"
 #include "pipeline/fragmentation/fragmenter.h"
 #include "pipeline/pipeline_step.h"
 
-class FragmentationLayer final : public PipelineStep
+template <typename Handler>
+class FragmentationLayer final : public PipelineLayer<Handler>
 {
-    std::map<std::string, FragmentAssembler> assembler_map;
+    using PipelineLayer<Handler>::handler;
+    using PipelineLayer<Handler>::gr;
+
+    /**
+     * Remontagens em andamento, indexadas pelo índice do nó de origem e
+     * depois pelo número da mensagem.
+    */
+    std::vector<std::unordered_map<uint32_t, FragmentAssembler>> assemblers;
+    std::mutex mutex_assemblers;
 
     Observer<ForwardDefragmentedMessage> obs_forward_defragmented_message;
     void forward_defragmented_message(const ForwardDefragmentedMessage& event);
+    Observer<PeerRemoved> obs_peer_removed;
+    void peer_removed(const PeerRemoved& event);
+    Observer<PeerIdle> obs_peer_idle;
+    void peer_idle(const PeerIdle& event);
 
-    std::string get_message_identifier(Packet p)
+    std::unordered_map<uint32_t, FragmentAssembler>& get_assemblers(uint32_t peer)
     {
-        return format("%s/%s", gr->get_node(p.meta.origin).get_address().to_string().c_str(), std::to_string(p.data.header.get_message_number()).c_str());
+        if (peer >= assemblers.size())
+            assemblers.resize(peer + 1);
+        return assemblers[peer];
     }
 
 public:
-    FragmentationLayer(PipelineHandler handler, GroupRegistry *gr);
-    ~FragmentationLayer() override;
+    FragmentationLayer(Handler handler, GroupRegistry *gr);
+    ~FragmentationLayer();
 
     void attach(EventBus&);
 
-    void send(Message) override;
-    void send(Packet) override;
+    void send(Message);
+    void send(Packet);
 
-    void receive(Packet) override;
+    void receive(Packet);
 };
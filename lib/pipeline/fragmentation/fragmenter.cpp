@@ -21,7 +21,8 @@ Packet Fragmenter::create_packet() {
         origin : message.origin,
         destination : message.destination,
         message_length : message_length,
-        expects_ack : 1
+        expects_ack : 1,
+        peer : message.peer
     };
 
     PacketData data = {
@@ -33,6 +34,7 @@ Packet Fragmenter::create_packet() {
             rst : 0,
             syn : 0,
             fin : 0,
+            wnd : 0,
             reserved: 0,
             end : last_fragment,
             type : message.type,
@@ -3,18 +3,53 @@
 #include "pipeline/fault_injection/fault_injection_layer.h"
 #include "pipeline/checksum/checksum_layer.h"
 
-Pipeline::Pipeline(GroupRegistry *gr, const FaultConfig& fault_config) : gr(gr)
+Pipeline::Pipeline(GroupRegistry *gr) : gr(gr)
 {
-    PipelineHandler handler = PipelineHandler(*this, event_bus, -1);
+}
+
+Pipeline::Pipeline(
+    GroupRegistry *gr,
+    const FaultConfig& fault_config,
+    const TransmissionConfig& transmission_config
+) : gr(gr)
+{
+    PipelineHandler handler = PipelineHandler(*this, event_bus, counters, -1);
+
+    // De cima para baixo: o canal começa a receber assim que é criado, e
+    // as camadas acima dele já precisam existir.
+    layers.resize(FRAGMENTATION_LAYER + 1);
+    layers[FRAGMENTATION_LAYER] = new FragmentationLayer<PipelineHandler>(handler.at_index(FRAGMENTATION_LAYER), gr);
+    layers[CHECKSUM_LAYER] = new ChecksumLayer<PipelineHandler>(handler.at_index(CHECKSUM_LAYER));
+    layers[TRANSMISSION_LAYER] = new TransmissionLayer<PipelineHandler>(handler.at_index(TRANSMISSION_LAYER), gr, transmission_config);
 
-    FaultInjectionLayer* fault_layer = new FaultInjectionLayer(handler.at_index(FAULT_INJECTION_LAYER), 200, 500, 0);
+    FaultInjectionLayer<PipelineHandler>* fault_layer = new FaultInjectionLayer<PipelineHandler>(
+        handler.at_index(FAULT_INJECTION_LAYER),
+        fault_config.min_delay,
+        fault_config.max_delay,
+        0
+    );
     fault_layer->enqueue_fault(fault_config.faults);
+    fault_layer->limit_bandwidth(fault_config.bandwidth, fault_config.link_queue_size);
+    layers[FAULT_INJECTION_LAYER] = fault_layer;
 
-    layers.push_back(new ChannelLayer(handler.at_index(CHANNEL_LAYER), gr->get_local_node().get_address()));
-    layers.push_back(fault_layer);
-    layers.push_back(new TransmissionLayer(handler.at_index(TRANSMISSION_LAYER), gr));
-    layers.push_back(new ChecksumLayer(handler.at_index(CHECKSUM_LAYER)));
-    layers.push_back(new FragmentationLayer(handler.at_index(FRAGMENTATION_LAYER), gr));
+    layers[CHANNEL_LAYER] = new ChannelLayer<PipelineHandler>(handler.at_index(CHANNEL_LAYER), gr, gr->get_local_node().get_address());
+    layer_names = {"channel", "fault_injection", "transmission", "checksum", "fragmentation", "connection"};
+
+    attach_layers();
+}
+
+Pipeline::Pipeline(GroupRegistry *gr, const std::vector<LayerFactory>& factories) : gr(gr)
+{
+    PipelineHandler handler = PipelineHandler(*this, event_bus, counters, -1);
+
+    // Também de cima para baixo, pelo mesmo motivo do construtor acima.
+    layers.resize(factories.size());
+    for (std::size_t layer = factories.size(); layer-- > 0;)
+        layers[layer] = factories[layer](handler.at_index(layer));
+
+    for (std::size_t layer = 0; layer < layers.size(); layer++)
+        layer_names.push_back(format("layer %zu", layer));
+    layer_names.push_back("connection");
 
     attach_layers();
 }
@@ -25,11 +60,12 @@ Pipeline::~Pipeline()
         delete layer;
 }
 
+
 PipelineStep *Pipeline::get_step(int step_index)
 {
     int total_layers = layers.size();
 
-    if (step_index >= total_layers)
+    if (step_index < 0 || step_index >= total_layers)
     {
         return nullptr;
     }
@@ -57,36 +93,69 @@ void Pipeline::send(Message message, int step_index)
 {
     PipelineStep *step = get_step(step_index);
     if (step)
+    {
+        Counters::LayerScope scope(counters, step_index, false);
         step->send(message);
+    }
 }
 void Pipeline::send(Packet packet, int step_index)
 {
     PipelineStep *step = get_step(step_index);
     if (step)
+    {
+        Counters::LayerScope scope(counters, step_index, false);
         step->send(packet);
+    }
 }
 
-void Pipeline::receive(Message message, int step_index)
+void Pipeline::receive(MessageHandle message, int step_index)
 {
+    Counters::LayerScope scope(counters, step_index, true);
+
     PipelineStep *step = get_step(step_index);
     if (step)
     {
-        step->receive(message);
+        step->receive(std::move(message));
         return;
     }
-    // TODO: na nova tentativa de conexão, dá pra chamar um metodo q faz a msm coisa q o establish_connections(), só q pra uma só
-    Connection &conn = gr->get_connection(message.origin);
-    conn.receive(message);
+    std::shared_ptr<Connection> conn = gr->get_connection(message->peer);
+    if (conn)
+        conn->receive(std::move(message));
 }
 void Pipeline::receive(Packet packet, int step_index)
 {
+    Counters::LayerScope scope(counters, step_index, true);
+
     PipelineStep *step = get_step(step_index);
     if (step)
     {
         step->receive(packet);
         return;
     }
-    // TODO: na nova tentativa de conexão, dá pra chamar um metodo q faz a msm coisa q o establish_connections(), só q pra uma só
-    Connection &conn = gr->get_connection(packet.meta.origin);
-    conn.receive(packet);
+    std::shared_ptr<Connection> conn = gr->get_connection(packet.meta.peer);
+    if (conn)
+        conn->receive(packet);
+}
+
+std::vector<LayerStats> Pipeline::get_layer_stats()
+{
+    std::vector<LayerStats> stats = counters.snapshot_layers(layer_names.size());
+    for (std::size_t layer = 0; layer < stats.size(); layer++)
+        stats[layer].name = layer_names[layer];
+    return stats;
+}
+
+std::map<std::string, RttStats> Pipeline::get_rtt_stats()
+{
+    TransmissionLayer<PipelineHandler> *transmission = find_layer<TransmissionLayer<PipelineHandler>>();
+    if (!transmission)
+        return {};
+    return transmission->get_rtt_stats();
+}
+std::map<std::string, CongestionStats> Pipeline::get_congestion_stats()
+{
+    TransmissionLayer<PipelineHandler> *transmission = find_layer<TransmissionLayer<PipelineHandler>>();
+    if (!transmission)
+        return {};
+    return transmission->get_congestion_stats();
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <vector>
 
 #include "pipeline/pipeline_handler.h"
@@ -13,13 +14,16 @@
 class PipelineStep;
 class ReliableCommunication;
 
+/**
+ * Pilha de camadas montada em tempo de execução. Cada camada chama a
+ * vizinha pelo índice, por meio do PipelineHandler. É a pilha padrão; o
+ * StaticProtocolPipeline (pipeline/protocol_stack.h) oferece a mesma pilha
+ * fixada em tempo de compilação.
+*/
 class Pipeline
 {
 private:
     std::vector<PipelineStep *> layers;
-    EventBus event_bus;
-
-    GroupRegistry *gr;
 
     friend PipelineHandler;
 
@@ -30,18 +34,39 @@ private:
     void send(Message message, int step_index);
     void send(Packet packet, int step_index);
 
-    void receive(Message message, int step_index);
+    void receive(MessageHandle message, int step_index);
     void receive(Packet packet, int step_index);
 
-    TransmissionLayer *get_transmission_layer()
-    {
-        return reinterpret_cast<TransmissionLayer *>(layers.at(TRANSMISSION_LAYER));
-    }
-    FragmentationLayer *get_fragmentation_layer()
+    /**
+     * Primeira camada do tipo `Layer` na pilha, ou nullptr.
+    */
+    template <typename Layer>
+    Layer *find_layer()
     {
-        return reinterpret_cast<FragmentationLayer *>(layers.at(FRAGMENTATION_LAYER));
+        for (PipelineStep *step : layers)
+        {
+            if (Layer *layer = dynamic_cast<Layer *>(step))
+                return layer;
+        }
+        return nullptr;
     }
 
+protected:
+    EventBus event_bus;
+    Counters counters;
+    /**
+     * Nome de cada camada nas estatísticas, seguido do da conexão, que
+     * recebe o que sai da camada mais alta.
+    */
+    std::vector<std::string> layer_names;
+
+    GroupRegistry *gr;
+
+    /**
+     * Para pilhas que não usam o vetor de camadas.
+    */
+    explicit Pipeline(GroupRegistry *gr);
+
 public:
     static const unsigned int CHANNEL_LAYER = 0;
     static const unsigned int FAULT_INJECTION_LAYER = 1;
@@ -49,9 +74,20 @@ public:
     static const unsigned int CHECKSUM_LAYER = 3;
     static const unsigned int FRAGMENTATION_LAYER = 4;
 
-    Pipeline(GroupRegistry *gr, const FaultConfig& fault_config);
+    /**
+     * Cria uma camada a partir do handler da posição que ela vai ocupar.
+    */
+    using LayerFactory = std::function<PipelineStep *(PipelineHandler)>;
+
+    Pipeline(GroupRegistry *gr, const FaultConfig& fault_config, const TransmissionConfig& transmission_config);
 
-    ~Pipeline();
+    /**
+     * Pilha montada em tempo de execução, da camada mais baixa para a mais
+     * alta.
+    */
+    Pipeline(GroupRegistry *gr, const std::vector<LayerFactory>& factories);
+
+    virtual ~Pipeline();
 
     template <typename T>
     void attach(Observer<T>& observer) {
@@ -63,6 +99,22 @@ public:
         event_bus.notify(event);
     };
 
-    void send(Message);
-    void send(Packet);
-};
\ No newline at end of file
+    virtual void send(Message);
+    virtual void send(Packet);
+
+    /**
+     * Vazios se a pilha não tem uma TransmissionLayer.
+    */
+    virtual std::map<std::string, RttStats> get_rtt_stats();
+    virtual std::map<std::string, CongestionStats> get_congestion_stats();
+
+    Counters &get_counters()
+    {
+        return counters;
+    }
+
+    /**
+     * Tempo gasto em cada camada e na entrega às conexões.
+    */
+    std::vector<LayerStats> get_layer_stats();
+};
@@ -1,8 +1,8 @@
 #include "pipeline/pipeline_handler.h"
 #include "pipeline/pipeline.h"
 
-PipelineHandler::PipelineHandler(Pipeline& pipeline, EventBus& event_bus, int step_index)
-    : pipeline(pipeline), event_bus(event_bus), step_index(step_index)
+PipelineHandler::PipelineHandler(Pipeline& pipeline, EventBus& event_bus, Counters& counters, int step_index)
+    : pipeline(pipeline), event_bus(event_bus), counters(counters), step_index(step_index)
 {
 }
 
@@ -19,7 +19,7 @@ void PipelineHandler::forward_receive(Packet packet)
 {
     pipeline.receive(packet, step_index + 1);
 }
-void PipelineHandler::forward_receive(Message message)
+void PipelineHandler::forward_receive(MessageHandle message)
 {
-    pipeline.receive(message, step_index + 1);
+    pipeline.receive(std::move(message), step_index + 1);
 }
@@ -1,18 +1,24 @@
 #pragma once
 
-#include <functional>
-
 #include "core/message.h"
+#include "core/message_pool.h"
 #include "core/packet.h"
 #include "core/event_bus.h"
+#include "core/counters.h"
 
 class Pipeline;
 
+/**
+ * Liga uma camada do Pipeline às vizinhas dela, resolvendo-as pelo índice
+ * em tempo de execução. O StaticHandler (pipeline/static_pipeline.h) é o
+ * equivalente para pilhas fixadas em tempo de compilação.
+*/
 class PipelineHandler
 {
 private:
     Pipeline& pipeline;
     EventBus& event_bus;
+    Counters& counters;
 
     int step_index;
 
@@ -22,20 +28,32 @@ private:
      * Método para facilmente criar pipeline handlers para cada step.
     */
     PipelineHandler at_index(int step_index) {
-        return PipelineHandler(pipeline, event_bus, step_index);
+        return PipelineHandler(pipeline, event_bus, counters, step_index);
     }
 
 public:
-    PipelineHandler(Pipeline& pipeline, EventBus& event_bus, int step_index);
+    PipelineHandler(Pipeline& pipeline, EventBus& event_bus, Counters& counters, int step_index);
 
     void forward_send(Packet);
     void forward_send(Message);
 
     void forward_receive(Packet);
-    void forward_receive(Message);
+    void forward_receive(MessageHandle);
 
     template <typename T>
     void notify(const T& event) {
         event_bus.notify(event);
     }
+
+    void count(uint32_t peer, Counter counter, uint64_t amount = 1) {
+        counters.add(peer, counter, amount);
+    }
+
+    /**
+     * Mede o tempo da camada deste handler até o retorno ser destruído,
+     * para trabalho que não passa pelo Pipeline, como a recepção do canal.
+    */
+    Counters::LayerScope measure(bool receiving) {
+        return Counters::LayerScope(counters, step_index, receiving);
+    }
 };
@@ -11,21 +11,50 @@
 class ReliableCommunication;
 class GroupRegistry;
 
+/**
+ * Interface das camadas vista pelo Pipeline, que as chama pelo índice.
+*/
 class PipelineStep
 {
-protected:
-    PipelineHandler handler;
-    GroupRegistry *gr;
 public:
-    PipelineStep(PipelineHandler &handler, GroupRegistry *gr);
-
     virtual ~PipelineStep();
 
     virtual void attach(EventBus&);
 
-    virtual void send(Packet packet);
-    virtual void send(Message);
+    virtual void send(Packet packet) = 0;
+    virtual void send(Message) = 0;
+
+    virtual void receive(Packet) = 0;
+    virtual void receive(MessageHandle) = 0;
+};
+
+/**
+ * Base das camadas. `Handler` é o PipelineHandler quando a camada está em
+ * um Pipeline e um StaticHandler quando está em um StaticPipeline; o que a
+ * camada não trata é repassado à vizinha por ele.
+*/
+template <typename Handler>
+class PipelineLayer : public PipelineStep
+{
+protected:
+    Handler handler;
+    GroupRegistry *gr;
+public:
+    using HandlerType = Handler;
+
+    PipelineLayer(Handler handler, GroupRegistry *gr) : handler(handler), gr(gr) {}
+
+    void send(Packet packet) override {
+        handler.forward_send(packet);
+    }
+    void send(Message message) override {
+        handler.forward_send(message);
+    }
 
-    virtual void receive(Packet);
-    virtual void receive(Message);
+    void receive(Packet packet) override {
+        handler.forward_receive(packet);
+    }
+    void receive(MessageHandle message) override {
+        handler.forward_receive(std::move(message));
+    }
 };
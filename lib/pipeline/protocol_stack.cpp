@@ -0,0 +1,65 @@
+#include "pipeline/protocol_stack.h"
+
+void ConnectionSink::receive(Packet& packet)
+{
+    std::shared_ptr<Connection> conn = gr->get_connection(packet.meta.peer);
+    if (conn)
+        conn->receive(packet);
+}
+
+void ConnectionSink::receive(MessageHandle& message)
+{
+    std::shared_ptr<Connection> conn = gr->get_connection(message->peer);
+    if (conn)
+        conn->receive(std::move(message));
+}
+
+ProtocolStack::ProtocolStack(
+    EventBus& event_bus,
+    Counters& counters,
+    GroupRegistry *gr,
+    const FaultConfig& fault_config,
+    const TransmissionConfig& transmission_config
+) : StaticPipeline(event_bus, counters, ConnectionSink{gr : gr})
+{
+    // De cima para baixo: o canal começa a receber assim que é criado, e
+    // as camadas acima dele já precisam existir.
+    create<Pipeline::FRAGMENTATION_LAYER>(gr);
+    create<Pipeline::CHECKSUM_LAYER>();
+    create<Pipeline::TRANSMISSION_LAYER>(gr, transmission_config);
+
+    auto& fault_layer = create<Pipeline::FAULT_INJECTION_LAYER>(fault_config.min_delay, fault_config.max_delay, 0);
+    fault_layer.enqueue_fault(fault_config.faults);
+    fault_layer.limit_bandwidth(fault_config.bandwidth, fault_config.link_queue_size);
+
+    create<Pipeline::CHANNEL_LAYER>(gr, gr->get_local_node().get_address());
+
+    attach_layers();
+}
+
+StaticProtocolPipeline::StaticProtocolPipeline(
+    GroupRegistry *gr,
+    const FaultConfig& fault_config,
+    const TransmissionConfig& transmission_config
+) : Pipeline(gr), stack(event_bus, counters, gr, fault_config, transmission_config)
+{
+    layer_names = {"channel", "fault_injection", "transmission", "checksum", "fragmentation", "connection"};
+}
+
+void StaticProtocolPipeline::send(Message message)
+{
+    stack.send(message);
+}
+void StaticProtocolPipeline::send(Packet packet)
+{
+    stack.send(packet);
+}
+
+std::map<std::string, RttStats> StaticProtocolPipeline::get_rtt_stats()
+{
+    return stack.layer<Pipeline::TRANSMISSION_LAYER>().get_rtt_stats();
+}
+std::map<std::string, CongestionStats> StaticProtocolPipeline::get_congestion_stats()
+{
+    return stack.layer<Pipeline::TRANSMISSION_LAYER>().get_congestion_stats();
+}
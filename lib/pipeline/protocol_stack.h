@@ -0,0 +1,68 @@
+#pragma once
+
+#include "pipeline/pipeline.h"
+#include "pipeline/static_pipeline.h"
+#include "pipeline/channel/channel_layer.h"
+#include "pipeline/fault_injection/fault_injection_layer.h"
+#include "pipeline/transmission/transmission_layer.h"
+#include "pipeline/checksum/checksum_layer.h"
+#include "pipeline/fragmentation/fragmentation_layer.h"
+
+class ProtocolStack;
+
+template <int I>
+using ProtocolHandler = StaticHandler<ProtocolStack, I>;
+
+/**
+ * Topo da pilha do protocolo: entrega à conexão com o nó de origem.
+*/
+struct ConnectionSink
+{
+    GroupRegistry *gr;
+
+    void receive(Packet& packet);
+    void receive(MessageHandle& message);
+};
+
+/**
+ * As camadas do Pipeline padrão, nas mesmas posições, fixadas em tempo de
+ * compilação.
+*/
+class ProtocolStack : public StaticPipeline<
+    ProtocolStack,
+    ConnectionSink,
+    ChannelLayer<ProtocolHandler<Pipeline::CHANNEL_LAYER>>,
+    FaultInjectionLayer<ProtocolHandler<Pipeline::FAULT_INJECTION_LAYER>>,
+    TransmissionLayer<ProtocolHandler<Pipeline::TRANSMISSION_LAYER>>,
+    ChecksumLayer<ProtocolHandler<Pipeline::CHECKSUM_LAYER>>,
+    FragmentationLayer<ProtocolHandler<Pipeline::FRAGMENTATION_LAYER>>
+>
+{
+public:
+    ProtocolStack(
+        EventBus& event_bus,
+        Counters& counters,
+        GroupRegistry *gr,
+        const FaultConfig& fault_config,
+        const TransmissionConfig& transmission_config
+    );
+};
+
+/**
+ * Pipeline que usa a ProtocolStack no lugar do vetor de camadas, trocando o
+ * índice e a chamada virtual de cada passagem por uma chamada direta.
+ * Escolhido com TransmissionConfig::static_pipeline.
+*/
+class StaticProtocolPipeline : public Pipeline
+{
+    ProtocolStack stack;
+
+public:
+    StaticProtocolPipeline(GroupRegistry *gr, const FaultConfig& fault_config, const TransmissionConfig& transmission_config);
+
+    void send(Message) override;
+    void send(Packet) override;
+
+    std::map<std::string, RttStats> get_rtt_stats() override;
+    std::map<std::string, CongestionStats> get_congestion_stats() override;
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "pipeline/pipeline_step.h"
+#include "core/event_bus.h"
+#include "core/counters.h"
+
+/**
+ * Liga a camada da posição `I` de `Stack` às vizinhas dela. Como a posição
+ * faz parte do tipo, forward_send e forward_receive chamam a camada vizinha
+ * pelo tipo concreto, sem índice em tempo de execução nem chamada virtual.
+ *
+ * Os corpos só são instanciados onde `Stack` está completa.
+*/
+template <typename Stack, int I>
+class StaticHandler
+{
+    Stack& stack;
+    EventBus& event_bus;
+    Counters& counters;
+
+public:
+    StaticHandler(Stack& stack, EventBus& event_bus, Counters& counters)
+        : stack(stack), event_bus(event_bus), counters(counters) {}
+
+    void forward_send(Packet packet) {
+        stack.template send_to<I - 1>(packet);
+    }
+    void forward_send(Message message) {
+        stack.template send_to<I - 1>(message);
+    }
+
+    void forward_receive(Packet packet) {
+        stack.template receive_at<I + 1>(packet);
+    }
+    void forward_receive(MessageHandle message) {
+        stack.template receive_at<I + 1>(message);
+    }
+
+    template <typename T>
+    void notify(const T& event) {
+        event_bus.notify(event);
+    }
+
+    void count(uint32_t peer, Counter counter, uint64_t amount = 1) {
+        counters.add(peer, counter, amount);
+    }
+
+    /**
+     * Mede o tempo da camada deste handler até o retorno ser destruído,
+     * para trabalho que não passa pela pilha, como a recepção do canal.
+    */
+    Counters::LayerScope measure(bool receiving) {
+        return Counters::LayerScope(counters, I, receiving);
+    }
+};
+
+/**
+ * Pilha de camadas fixada em tempo de compilação, da mais baixa para a mais
+ * alta. É a alternativa ao Pipeline para quem conhece a pilha de antemão:
+ * cada camada `Layers[I]` é instanciada com StaticHandler<Derived, I>, e a
+ * passagem para a vizinha é uma chamada qualificada, não virtual, ao tipo
+ * concreto dela. O que sai da camada mais alta vai para `top`, que recebe
+ * receive(Packet&) e receive(MessageHandle&).
+ *
+ * Quem herda (`Derived`) cria as camadas com create(), da mais alta para a
+ * mais baixa, e depois chama attach_layers(). O EventBus e os Counters são
+ * de quem monta a pilha.
+*/
+template <typename Derived, typename Top, typename... Layers>
+class StaticPipeline
+{
+public:
+    static constexpr int SIZE = sizeof...(Layers);
+
+    template <int I>
+    using LayerAt = std::tuple_element_t<I, std::tuple<Layers...>>;
+
+    StaticPipeline(const StaticPipeline&) = delete;
+    StaticPipeline& operator=(const StaticPipeline&) = delete;
+
+    template <int I>
+    LayerAt<I>& layer()
+    {
+        return *std::get<I>(layers);
+    }
+
+    void send(Message message)
+    {
+        send_to<SIZE - 1>(message);
+    }
+    void send(Packet packet)
+    {
+        send_to<SIZE - 1>(packet);
+    }
+
+    /**
+     * Entrega à camada `I`. Abaixo da camada mais baixa não há para onde
+     * enviar. Uma camada que não declara a sobrecarga usa a de
+     * PipelineLayer, que só repassa.
+    */
+    template <int I, typename T>
+    void send_to(T& data)
+    {
+        if constexpr (I >= 0)
+        {
+            using Layer = LayerAt<I>;
+            Layer& layer = *std::get<I>(layers);
+
+            Counters::LayerScope scope(counters, I, false);
+            if constexpr (requires { layer.Layer::send(data); })
+                layer.Layer::send(data);
+            else
+                layer.PipelineLayer<typename Layer::HandlerType>::send(data);
+        }
+    }
+
+    template <int I>
+    void receive_at(Packet& packet)
+    {
+        Counters::LayerScope scope(counters, I, true);
+
+        if constexpr (I < SIZE)
+        {
+            using Layer = LayerAt<I>;
+            Layer& layer = *std::get<I>(layers);
+
+            if constexpr (requires { layer.Layer::receive(packet); })
+                layer.Layer::receive(packet);
+            else
+                layer.PipelineLayer<typename Layer::HandlerType>::receive(packet);
+        }
+        else
+        {
+            top.receive(packet);
+        }
+    }
+
+    template <int I>
+    void receive_at(MessageHandle& message)
+    {
+        Counters::LayerScope scope(counters, I, true);
+
+        if constexpr (I < SIZE)
+        {
+            using Layer = LayerAt<I>;
+            Layer& layer = *std::get<I>(layers);
+
+            if constexpr (requires { layer.Layer::receive(std::move(message)); })
+                layer.Layer::receive(std::move(message));
+            else
+                layer.PipelineLayer<typename Layer::HandlerType>::receive(std::move(message));
+        }
+        else
+        {
+            top.receive(message);
+        }
+    }
+
+protected:
+    EventBus& event_bus;
+    Counters& counters;
+
+    Top top;
+
+    StaticPipeline(EventBus& event_bus, Counters& counters, Top top)
+        : event_bus(event_bus), counters(counters), top(std::move(top)) {}
+
+    /**
+     * A camada mais baixa para primeiro, já que é ela que recebe da rede.
+    */
+    ~StaticPipeline()
+    {
+        std::apply([](auto&... layer) { (layer.reset(), ...); }, layers);
+    }
+
+    /**
+     * Cria a camada da posição `I` com o handler dessa posição.
+    */
+    template <int I, typename... Args>
+    LayerAt<I>& create(Args&&... args)
+    {
+        using Handler = StaticHandler<Derived, I>;
+        static_assert(std::is_same_v<typename LayerAt<I>::HandlerType, Handler>, "layer at position I must take StaticHandler<Derived, I>");
+
+        std::unique_ptr<LayerAt<I>>& slot = std::get<I>(layers);
+        slot.reset(new LayerAt<I>(Handler(static_cast<Derived&>(*this), event_bus, counters), std::forward<Args>(args)...));
+        return *slot;
+    }
+
+    void attach_layers()
+    {
+        std::apply([this](auto&... layer) { (layer->attach(event_bus), ...); }, layers);
+    }
+
+private:
+    std::tuple<std::unique_ptr<Layers>...> layers;
+};
@@ -0,0 +1,90 @@
+#include <algorithm>
+
+#include "pipeline/transmission/congestion_controller.h"
+#include "utils/date.h"
+
+std::unique_ptr<CongestionController> CongestionController::create(CongestionControl type, WindowLimits limits)
+{
+    if (type == CongestionControl::VEGAS)
+        return std::make_unique<VegasController>(limits);
+    return std::make_unique<NewRenoController>(limits);
+}
+
+CongestionController::~CongestionController() {}
+
+
+NewRenoController::NewRenoController(WindowLimits limits)
+    : limits(limits), window(limits.initial), ssthresh(limits.max) {}
+
+bool NewRenoController::in_slow_start()
+{
+    return window < ssthresh;
+}
+
+uint32_t NewRenoController::get_window()
+{
+    return window;
+}
+
+void NewRenoController::on_ack(double)
+{
+    if (in_slow_start())
+        window += 1;
+    else
+        window += 1 / window;
+
+    window = std::min(window, (double) limits.max);
+}
+
+void NewRenoController::on_timeout(uint64_t sent_at)
+{
+    // Fragmentos enviados antes da última redução pertencem à janela que já
+    // foi penalizada.
+    if (sent_at < recovery_start)
+        return;
+
+    ssthresh = std::max(window / 2, (double) limits.min);
+    window = ssthresh;
+    recovery_start = DateUtils::monotonic_us();
+
+    log_debug("Congestion window reduced to ", window, " packets.");
+}
+
+
+void VegasController::on_ack(double rtt)
+{
+    if (rtt >= 0)
+    {
+        base_rtt = base_rtt < 0 ? rtt : std::min(base_rtt, rtt);
+        round_min_rtt = round_min_rtt < 0 ? rtt : std::min(round_min_rtt, rtt);
+    }
+
+    if (in_slow_start())
+        window = std::min(window + 1, (double) limits.max);
+
+    round_acks++;
+    if (round_acks >= window)
+        end_round();
+}
+
+void VegasController::end_round()
+{
+    if (round_min_rtt > 0)
+    {
+        // Quantidade estimada de fragmentos desta conexão parados em filas.
+        double queued = window * (1 - base_rtt / round_min_rtt);
+
+        if (in_slow_start())
+        {
+            if (queued > GAMMA)
+                ssthresh = window;
+        }
+        else if (queued < ALPHA)
+            window = std::min(window + 1, (double) limits.max);
+        else if (queued > BETA)
+            window = std::max(window - 1, (double) limits.min);
+    }
+
+    round_acks = 0;
+    round_min_rtt = -1;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <cstdint>
+
+enum CongestionControl {
+    NEW_RENO = 0,
+    VEGAS = 1
+};
+
+/**
+ * Tamanhos, em fragmentos, da janela de congestionamento.
+*/
+struct WindowLimits {
+    uint32_t initial;
+    uint32_t min;
+    uint32_t max;
+};
+
+/**
+ * Controle de congestionamento de uma conexão. Define quantos fragmentos
+ * podem estar em trânsito (sem ACK) ao mesmo tempo.
+*/
+class CongestionController
+{
+public:
+    static std::unique_ptr<CongestionController> create(CongestionControl type, WindowLimits limits);
+
+    virtual ~CongestionController();
+
+    virtual uint32_t get_window() = 0;
+
+    virtual bool in_slow_start() = 0;
+
+    /**
+     * Chamado a cada fragmento confirmado. `rtt` é a amostra de RTT em ms do
+     * fragmento, ou negativo se ele foi retransmitido (regra de Karn).
+    */
+    virtual void on_ack(double rtt) = 0;
+
+    /**
+     * Chamado quando um fragmento enviado no instante `sent_at` (em µs) expira.
+    */
+    virtual void on_timeout(uint64_t sent_at) = 0;
+};
+
+/**
+ * AIMD no estilo NewReno: slow start até o limiar e depois um fragmento a
+ * mais por janela confirmada. Como a única indicação de perda é o timeout, a
+ * janela é reduzida à metade somente uma vez para todos os fragmentos que
+ * estavam em trânsito quando a perda foi detectada.
+*/
+class NewRenoController : public CongestionController
+{
+protected:
+    WindowLimits limits;
+    double window;
+    double ssthresh;
+    uint64_t recovery_start = 0;
+
+public:
+    NewRenoController(WindowLimits limits);
+
+    uint32_t get_window() override;
+
+    bool in_slow_start() override;
+
+    void on_ack(double rtt) override;
+    void on_timeout(uint64_t sent_at) override;
+};
+
+/**
+ * Controle baseado em atraso no estilo TCP Vegas. A cada janela compara a
+ * vazão esperada (pelo menor RTT observado) com a vazão real e mantém entre
+ * ALPHA e BETA fragmentos enfileirados no caminho. Timeouts são tratados
+ * como no NewReno.
+*/
+class VegasController : public NewRenoController
+{
+    static constexpr double ALPHA = 2;
+    static constexpr double BETA = 4;
+    static constexpr double GAMMA = 1;
+
+    double base_rtt = -1;
+    double round_min_rtt = -1;
+    uint32_t round_acks = 0;
+
+    void end_round();
+
+public:
+    using NewRenoController::NewRenoController;
+
+    void on_ack(double rtt) override;
+};
@@ -0,0 +1,15 @@
+#include "pipeline/transmission/pacer.h"
+
+PacingClock::time_point Pacer::schedule(uint32_t bytes, double rate)
+{
+    PacingClock::time_point now = PacingClock::now();
+    PacingClock::time_point release = std::max(now, next_release);
+
+    if (rate > 0)
+        next_release = release + std::chrono::nanoseconds((uint64_t) (bytes * 1e9 / rate));
+    else
+        next_release = now;
+
+    return release;
+}
+
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+
+using PacingClock = std::chrono::steady_clock;
+
+/**
+ * Calcula quando cada pacote de uma conexão pode sair para que a conexão não
+ * exceda uma taxa de envio. Não acumula crédito enquanto a conexão está
+ * ociosa, então nunca libera rajadas.
+*/
+class Pacer
+{
+    PacingClock::time_point next_release{};
+
+public:
+    /**
+     * Reserva o envio de um pacote de `bytes` bytes a uma taxa de `rate`
+     * bytes/s e retorna o instante em que ele pode ser enviado. Taxa 0
+     * libera o pacote imediatamente.
+    */
+    PacingClock::time_point schedule(uint32_t bytes, double rate);
+};
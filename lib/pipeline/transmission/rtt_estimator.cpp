@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <cmath>
+
+#include "pipeline/transmission/rtt_estimator.h"
+
+RttEstimator::RttEstimator(uint32_t initial_rto, uint32_t min_rto, uint32_t max_rto)
+    : rto(initial_rto), min_rto(min_rto), max_rto(max_rto) {}
+
+uint32_t RttEstimator::clamp(double timeout)
+{
+    return std::clamp((uint32_t) std::ceil(timeout), min_rto, max_rto);
+}
+
+void RttEstimator::add_sample(double rtt)
+{
+    mutex.lock();
+
+    if (!samples)
+    {
+        srtt = rtt;
+        rttvar = rtt / 2;
+    }
+    else
+    {
+        rttvar = (1 - BETA) * rttvar + BETA * std::abs(srtt - rtt);
+        srtt = (1 - ALPHA) * srtt + ALPHA * rtt;
+    }
+    samples++;
+
+    rto = clamp(srtt + std::max(CLOCK_GRANULARITY, K * rttvar));
+
+    mutex.unlock();
+}
+
+void RttEstimator::backoff(uint32_t timeout)
+{
+    mutex.lock();
+    rto = std::max(rto, clamp(2.0 * timeout));
+    mutex.unlock();
+}
+
+uint32_t RttEstimator::get_timeout()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return rto;
+}
+
+RttStats RttEstimator::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return RttStats{srtt, rttvar, rto, samples};
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <mutex>
+#include <cstdint>
+
+struct RttStats {
+    double srtt;
+    double rttvar;
+    uint32_t rto;
+    uint32_t samples;
+};
+
+/**
+ * Estimador de RTT de uma conexão no estilo da RFC 6298. Mantém o RTT
+ * suavizado (SRTT) e sua variação (RTTVAR), e deriva deles o tempo de
+ * retransmissão (RTO). Todos os valores são em milissegundos.
+*/
+class RttEstimator
+{
+    static constexpr double ALPHA = 1.0 / 8;
+    static constexpr double BETA = 1.0 / 4;
+    static constexpr int K = 4;
+    static constexpr double CLOCK_GRANULARITY = 1;
+
+    std::mutex mutex;
+
+    double srtt = 0;
+    double rttvar = 0;
+    uint32_t rto;
+    uint32_t samples = 0;
+
+    uint32_t min_rto;
+    uint32_t max_rto;
+
+    uint32_t clamp(double timeout);
+
+public:
+    /**
+     * `initial_rto` é usado até a primeira amostra; o RTO fica sempre entre
+     * `min_rto` e `max_rto`.
+    */
+    RttEstimator(uint32_t initial_rto, uint32_t min_rto, uint32_t max_rto);
+
+    /**
+     * Registra uma amostra de RTT. Pela regra de Karn, somente pacotes que
+     * não foram retransmitidos devem gerar amostras.
+    */
+    void add_sample(double rtt);
+
+    /**
+     * Dobra o RTO após um timeout de um pacote enviado com `timeout`. Vários
+     * timeouts de pacotes enviados com o mesmo RTO dobram ele uma única vez.
+    */
+    void backoff(uint32_t timeout);
+
+    uint32_t get_timeout();
+
+    RttStats get_stats();
+};
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <stdexcept>
+
+#include "pipeline/transmission/transmission_config.h"
+#include "utils/format.h"
+
+static const std::map<std::string, uint32_t TransmissionConfig::*> numeric_settings = {
+    {"max_pacing_rate", &TransmissionConfig::max_pacing_rate},
+    {"ack_timeout", &TransmissionConfig::ack_timeout},
+    {"min_ack_timeout", &TransmissionConfig::min_ack_timeout},
+    {"max_ack_timeout", &TransmissionConfig::max_ack_timeout},
+    {"max_packet_tries", &TransmissionConfig::max_packet_tries},
+    {"initial_congestion_window", &TransmissionConfig::initial_congestion_window},
+    {"min_congestion_window", &TransmissionConfig::min_congestion_window},
+    {"max_congestion_window", &TransmissionConfig::max_congestion_window},
+    {"handshake_timeout", &TransmissionConfig::handshake_timeout},
+    {"max_enqueued_transmissions", &TransmissionConfig::max_enqueued_transmissions},
+    {"sender_workers", &TransmissionConfig::sender_workers},
+    {"receive_buffer_items", &TransmissionConfig::receive_buffer_items},
+    {"connection_idle_timeout", &TransmissionConfig::connection_idle_timeout}};
+
+static uint32_t parse_number(const std::string& key, const std::string& value)
+{
+    bool digits = value.size() && std::all_of(value.begin(), value.end(), [](char ch) { return isdigit(ch); });
+    if (!digits || value.size() > 10 || std::stoull(value) > UINT32_MAX)
+        throw std::invalid_argument(format("Invalid value '%s' for %s.", value.c_str(), key.c_str()));
+    return std::stoul(value);
+}
+
+void TransmissionConfig::set(const std::string& key, const std::string& value)
+{
+    auto numeric = numeric_settings.find(key);
+    if (numeric != numeric_settings.end())
+    {
+        this->*(numeric->second) = parse_number(key, value);
+        return;
+    }
+
+    if (key == "congestion_control" && value == "newreno")
+        congestion_control = CongestionControl::NEW_RENO;
+    else if (key == "congestion_control" && value == "vegas")
+        congestion_control = CongestionControl::VEGAS;
+    else if (key == "pacing" && (value == "true" || value == "false"))
+        pacing = value == "true";
+    else if (key == "static_pipeline" && (value == "true" || value == "false"))
+        static_pipeline = value == "true";
+    else if (key == "congestion_control" || key == "pacing" || key == "static_pipeline")
+        throw std::invalid_argument(format("Invalid value '%s' for %s.", value.c_str(), key.c_str()));
+    else
+        throw std::invalid_argument(format("Unknown setting %s.", key.c_str()));
+}
+
+void TransmissionConfig::apply(const std::vector<std::pair<std::string, std::string>>& settings)
+{
+    for (const auto& [key, value] : settings)
+        set(key, value);
+}
+
+void TransmissionConfig::validate() const
+{
+    if (!min_ack_timeout || min_ack_timeout > max_ack_timeout)
+        throw std::invalid_argument("min_ack_timeout must be positive and at most max_ack_timeout.");
+    if (ack_timeout < min_ack_timeout || ack_timeout > max_ack_timeout)
+        throw std::invalid_argument("ack_timeout must be between min_ack_timeout and max_ack_timeout.");
+    if (!max_packet_tries)
+        throw std::invalid_argument("max_packet_tries must be positive.");
+    if (!min_congestion_window || min_congestion_window > max_congestion_window)
+        throw std::invalid_argument("min_congestion_window must be positive and at most max_congestion_window.");
+    if (initial_congestion_window < min_congestion_window || initial_congestion_window > max_congestion_window)
+        throw std::invalid_argument("initial_congestion_window must be between the minimum and maximum windows.");
+    if (!max_enqueued_transmissions || !receive_buffer_items || !sender_workers)
+        throw std::invalid_argument("max_enqueued_transmissions, receive_buffer_items and sender_workers must be positive.");
+    if (connection_idle_timeout && connection_idle_timeout < MIN_CONNECTION_IDLE_TIMEOUT)
+        throw std::invalid_argument(format("connection_idle_timeout must be 0 (disabled) or at least %d ms.", MIN_CONNECTION_IDLE_TIMEOUT));
+}
+
+bool TransmissionConfig::is_instance_setting(const std::string& key)
+{
+    return key == "sender_workers" || key == "receive_buffer_items" || key == "connection_idle_timeout" || key == "static_pipeline";
+}
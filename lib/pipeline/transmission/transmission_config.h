@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "core/constants.h"
+#include "pipeline/transmission/congestion_controller.h"
+
+/**
+ * Parâmetros do protocolo. Os padrões são as constantes de core/constants.h
+ * e podem ser trocados por instância (ReliableCommunication), por nó
+ * (peer_configs do construtor) ou pelo nodes.conf, sem recompilar.
+ *
+ * Os campos marcados como "da instância" valem para o processo inteiro e
+ * não podem ser definidos por nó.
+*/
+struct TransmissionConfig {
+    CongestionControl congestion_control = CongestionControl::NEW_RENO;
+    /**
+     * Espaça os fragmentos de cada conexão de acordo com a banda estimada
+     * (janela de congestionamento / SRTT) em vez de enviá-los em rajada.
+    */
+    bool pacing = true;
+    /**
+     * Taxa máxima de envio em bytes/s de cada conexão. 0 não impõe limite.
+    */
+    uint32_t max_pacing_rate = 0;
+
+    /**
+     * RTO inicial e limites do RTO, em ms.
+    */
+    uint32_t ack_timeout = ACK_TIMEOUT;
+    uint32_t min_ack_timeout = MIN_ACK_TIMEOUT;
+    uint32_t max_ack_timeout = MAX_ACK_TIMEOUT;
+    /**
+     * Tentativas de envio de um fragmento antes de a transmissão falhar.
+    */
+    uint32_t max_packet_tries = MAX_PACKET_TRIES;
+
+    uint32_t initial_congestion_window = INITIAL_CONGESTION_WINDOW;
+    uint32_t min_congestion_window = MIN_CONGESTION_WINDOW;
+    uint32_t max_congestion_window = MAX_CONGESTION_WINDOW;
+
+    uint32_t handshake_timeout = HANDSHAKE_TIMEOUT;
+    /**
+     * Mensagens aguardando envio em cada conexão antes de send() bloquear.
+    */
+    uint32_t max_enqueued_transmissions = MAX_ENQUEUED_TRANSMISSIONS;
+
+    /**
+     * Da instância: quantidade de threads que executam os envios das
+     * conexões. Cada conexão é atendida por um worker de cada vez.
+    */
+    uint32_t sender_workers = 1;
+    /**
+     * Da instância: mensagens recebidas aguardando receive().
+    */
+    uint32_t receive_buffer_items = INTERMEDIARY_BUFFER_ITEMS;
+    /**
+     * Da instância: tempo sem tráfego, em ms, após o qual a conexão com um
+     * nó é desfeita. 0 mantém as conexões enquanto o nó existir.
+    */
+    uint32_t connection_idle_timeout = CONNECTION_IDLE_TIMEOUT;
+    /**
+     * Da instância: monta as camadas com a ProtocolStack, fixada em tempo de
+     * compilação, em vez do Pipeline em tempo de execução.
+    */
+    bool static_pipeline = false;
+
+    /**
+     * Atribui o parâmetro `key` a partir do texto do nodes.conf, ex.:
+     * set("ack_timeout", "200"). Lança std::invalid_argument para nomes ou
+     * valores inválidos.
+    */
+    void set(const std::string& key, const std::string& value);
+
+    /**
+     * Aplica os pares na ordem, com set().
+    */
+    void apply(const std::vector<std::pair<std::string, std::string>>& settings);
+
+    /**
+     * Lança std::invalid_argument se os limites forem incoerentes, ex.:
+     * min_ack_timeout maior que max_ack_timeout.
+    */
+    void validate() const;
+
+    bool operator==(const TransmissionConfig& other) const = default;
+
+    static bool is_instance_setting(const std::string& key);
+};
+
+/**
+ * Parâmetros de nós específicos, pelo id do nó. Substituem por inteiro a
+ * configuração da instância para esses nós.
+*/
+using PeerConfigs = std::unordered_map<std::string, TransmissionConfig>;
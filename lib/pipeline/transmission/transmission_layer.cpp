@@ -1,72 +1,201 @@
+#include <algorithm>
+
 #include "pipeline/transmission/transmission_layer.h"
+#include "pipeline/protocol_stack.h"
 
-TransmissionLayer::TransmissionLayer(PipelineHandler handler, GroupRegistry *gr) : PipelineStep(handler, gr)
+template <typename Handler>
+TransmissionLayer<Handler>::TransmissionLayer(Handler handler, GroupRegistry *gr, const TransmissionConfig& config)
+    : PipelineLayer<Handler>(handler, gr), config(std::make_shared<const TransmissionConfig>(config))
 {
 }
 
-TransmissionLayer::~TransmissionLayer()
+template <typename Handler>
+TransmissionLayer<Handler>::~TransmissionLayer()
 {
 }
 
-TransmissionQueue& TransmissionLayer::get_queue(const std::string& id) {
-    if (!queue_map.contains(id))
-        queue_map.insert({id, std::make_unique<TransmissionQueue>(timer, handler)});
-    return *queue_map.at(id);
+template <typename Handler>
+std::shared_ptr<TransmissionQueue<Handler>> TransmissionLayer<Handler>::get_queue(uint32_t peer) {
+    std::lock_guard<std::mutex> lock(mutex_queues);
+
+    if (peer >= queues.size())
+        queues.resize(peer + 1);
+
+    std::shared_ptr<TransmissionQueue<Handler>>& queue = queues[peer];
+    if (!queue)
+        queue = std::make_shared<TransmissionQueue<Handler>>(handler, gr ? gr->get_config(peer) : config);
+    return queue;
+}
+
+template <typename Handler>
+std::string TransmissionLayer<Handler>::stats_key(uint32_t peer) {
+    return gr ? gr->get_peer(peer).get_id() : std::to_string(peer);
+}
+
+template <typename Handler>
+std::map<std::string, RttStats> TransmissionLayer<Handler>::get_rtt_stats() {
+    std::lock_guard<std::mutex> lock(mutex_queues);
+
+    std::map<std::string, RttStats> stats;
+    for (uint32_t peer = 0; peer < queues.size(); peer++)
+    {
+        if (queues[peer])
+            stats.emplace(stats_key(peer), queues[peer]->get_rtt_stats());
+    }
+    return stats;
+}
+
+template <typename Handler>
+std::map<std::string, CongestionStats> TransmissionLayer<Handler>::get_congestion_stats() {
+    std::lock_guard<std::mutex> lock(mutex_queues);
+
+    std::map<std::string, CongestionStats> stats;
+    for (uint32_t peer = 0; peer < queues.size(); peer++)
+    {
+        if (queues[peer])
+            stats.emplace(stats_key(peer), queues[peer]->get_congestion_stats());
+    }
+    return stats;
 }
 
-void TransmissionLayer::attach(EventBus& bus) {
+template <typename Handler>
+void TransmissionLayer<Handler>::attach(EventBus& bus) {
     obs_ack_received.on(std::bind(&TransmissionLayer::ack_received, this, _1));
     bus.attach(obs_ack_received);
+    obs_window_update_received.on(std::bind(&TransmissionLayer::window_update_received, this, _1));
+    bus.attach(obs_window_update_received);
+    obs_receive_batch_started.on(std::bind(&TransmissionLayer::receive_batch_started, this, _1));
+    bus.attach(obs_receive_batch_started);
+    obs_receive_batch_finished.on(std::bind(&TransmissionLayer::receive_batch_finished, this, _1));
+    bus.attach(obs_receive_batch_finished);
     obs_pipeline_cleanup.on(std::bind(&TransmissionLayer::pipeline_cleanup, this, _1));
     bus.attach(obs_pipeline_cleanup);
+    obs_peer_removed.on(std::bind(&TransmissionLayer::peer_removed, this, _1));
+    bus.attach(obs_peer_removed);
+    obs_peer_idle.on(std::bind(&TransmissionLayer::peer_idle, this, _1));
+    bus.attach(obs_peer_idle);
 }
 
-void TransmissionLayer::send(Packet packet)
+template <typename Handler>
+void TransmissionLayer<Handler>::send(Packet packet)
 {
-    log_trace("Packet [", packet.to_string(PacketFormat::SENT), "] sent to transmission layer.");
+    log_trace("Packet [", packet.summary(PacketFormat::SENT), "] sent to transmission layer.");
 
     if (!packet.meta.expects_ack)
     {
-        log_debug("Packet [", packet.to_string(PacketFormat::SENT), "] does not require ACK, sending forward.");
+        log_debug("Packet [", packet.summary(PacketFormat::SENT), "] does not require ACK, sending forward.");
         handler.forward_send(packet);
         return;
     }
 
-    const Node& destination = gr->get_node(packet.meta.destination);
-    const std::string& id = destination.get_id();
-    TransmissionQueue& queue = get_queue(id);
-    queue.add_packet(packet);
+    get_queue(packet.meta.peer)->add_packet(packet);
 }
 
-void TransmissionLayer::ack_received(const PacketAckReceived& event) {    
+template <typename Handler>
+void TransmissionLayer<Handler>::ack_received(const PacketAckReceived& event) {    
     Packet& packet = event.ack_packet;
 
-    const Node& origin = gr->get_node(packet.meta.origin);
-    const std::string& id = origin.get_id();
-    TransmissionQueue& queue = get_queue(id);
+    if (batch_thread == std::this_thread::get_id())
+    {
+        ack_batch.push_back(packet);
+        return;
+    }
+
+    get_queue(packet.meta.peer)->receive_ack(packet);
+}
+
+template <typename Handler>
+void TransmissionLayer<Handler>::receive_batch_started(const ReceiveBatchStarted&) {
+    batch_thread = std::this_thread::get_id();
+}
+
+template <typename Handler>
+void TransmissionLayer<Handler>::receive_batch_finished(const ReceiveBatchFinished&) {
+    batch_thread = std::thread::id();
+
+    if (!ack_batch.size()) return;
+
+    // Agrupa os ACKs por fila, na ordem em que chegaram, para que cada fila
+    // processe os seus com uma única aquisição de lock.
+    std::vector<std::pair<std::shared_ptr<TransmissionQueue<Handler>>, std::vector<Packet>>> batches;
+    SocketAddress last_origin{};
+    std::shared_ptr<TransmissionQueue<Handler>> queue;
+
+    for (Packet& packet : ack_batch)
+    {
+        if (!queue || !(packet.meta.origin == last_origin))
+        {
+            queue = get_queue(packet.meta.peer);
+            last_origin = packet.meta.origin;
+        }
+
+        auto batch = std::find_if(batches.begin(), batches.end(), [&](auto& batch) { return batch.first == queue; });
+        if (batch == batches.end())
+            batch = batches.insert(batches.end(), {queue, {}});
+
+        batch->second.push_back(packet);
+    }
+
+    ack_batch.clear();
+
+    for (auto& [queue, packets] : batches)
+        queue->receive_acks(packets);
+}
+
+template <typename Handler>
+void TransmissionLayer<Handler>::window_update_received(const WindowUpdateReceived& event) {
+    Packet& packet = event.update_packet;
 
-    queue.receive_ack(packet);
+    get_queue(packet.meta.peer)->receive_window_update(packet);
 }
 
-void TransmissionLayer::pipeline_cleanup(const PipelineCleanup& event) {    
+template <typename Handler>
+void TransmissionLayer<Handler>::pipeline_cleanup(const PipelineCleanup& event) {    
     Message& message = event.message;
 
-    const Node& origin = gr->get_node(message.destination);
-    const std::string& id = origin.get_id();
-    TransmissionQueue& queue = get_queue(id);
+    get_queue(message.peer)->reset();
+}
+
+template <typename Handler>
+void TransmissionLayer<Handler>::peer_removed(const PeerRemoved& event) {
+    std::shared_ptr<TransmissionQueue<Handler>> queue;
 
-    queue.reset();
+    mutex_queues.lock();
+    if (event.peer < queues.size())
+        queue = std::move(queues[event.peer]);
+    mutex_queues.unlock();
+
+    log_debug("Dropped transmission queue of node ", event.peer, ".");
 }
 
-void TransmissionLayer::receive(Packet packet)
+template <typename Handler>
+void TransmissionLayer<Handler>::peer_idle(const PeerIdle& event) {
+    std::shared_ptr<TransmissionQueue<Handler>> queue;
+
+    mutex_queues.lock();
+    if (event.peer < queues.size() && queues[event.peer].use_count() == 1 && queues[event.peer]->idle())
+        queue = std::move(queues[event.peer]);
+    mutex_queues.unlock();
+
+    if (queue)
+    {
+        log_debug("Released idle transmission queue of node ", event.peer, ".");
+    }
+}
+
+template <typename Handler>
+void TransmissionLayer<Handler>::receive(Packet packet)
 {
-    log_trace("Packet [", packet.to_string(PacketFormat::RECEIVED), "] received on transmission layer.");
+    log_trace("Packet [", packet.summary(PacketFormat::RECEIVED), "] received on transmission layer.");
 
     if (!gr->packet_originates_from_group(packet))
     {
-        log_debug("Packet ", packet.to_string(PacketFormat::RECEIVED), " does not originate from group; dropping.");
+        log_debug("Packet ", packet.summary(PacketFormat::RECEIVED), " does not originate from group; dropping.");
         return;
     }
 
     handler.forward_receive(packet);
 }
+
+template class TransmissionLayer<PipelineHandler>;
+template class TransmissionLayer<ProtocolHandler<Pipeline::TRANSMISSION_LAYER>>;
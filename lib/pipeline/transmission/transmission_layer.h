@@ -4,34 +4,79 @@
 #include <thread>
 #include <atomic>
 #include <memory>
+#include <map>
+#include <mutex>
 
 #include "pipeline/pipeline_step.h"
 #include "pipeline/transmission/transmission_queue.h"
+#include "pipeline/transmission/transmission_config.h"
 #include "core/node.h"
 #include "core/message.h"
 #include "core/packet.h"
 #include "core/buffer.h"
 
-class TransmissionLayer : public PipelineStep
+template <typename Handler>
+class TransmissionLayer : public PipelineLayer<Handler>
 {
+    using PipelineLayer<Handler>::handler;
+    using PipelineLayer<Handler>::gr;
+
 private:
-    Timer timer;
+    /**
+     * Parâmetros usados quando não há GroupRegistry; com ele, cada fila usa
+     * os parâmetros do seu nó.
+    */
+    std::shared_ptr<const TransmissionConfig> config;
+
+    /**
+     * Filas indexadas pelo índice do nó, criadas no primeiro uso e
+     * descartadas quando a conexão com o nó fica ociosa. Quem usa uma fila
+     * guarda uma referência a ela, para que o descarte espere o uso
+     * terminar.
+    */
+    std::vector<std::shared_ptr<TransmissionQueue<Handler>>> queues;
+    std::mutex mutex_queues;
 
-    std::unordered_map<std::string, std::unique_ptr<TransmissionQueue>> queue_map;
+    /**
+     * Thread que está repassando um lote de pacotes do canal. Os ACKs
+     * recebidos por ela são acumulados em `ack_batch` e processados juntos
+     * no fim do lote.
+    */
+    std::atomic<std::thread::id> batch_thread{};
+    std::vector<Packet> ack_batch;
 
     Observer<PacketAckReceived> obs_ack_received;
     void ack_received(const PacketAckReceived& event);
+    Observer<WindowUpdateReceived> obs_window_update_received;
+    void window_update_received(const WindowUpdateReceived& event);
+    Observer<ReceiveBatchStarted> obs_receive_batch_started;
+    void receive_batch_started(const ReceiveBatchStarted& event);
+    Observer<ReceiveBatchFinished> obs_receive_batch_finished;
+    void receive_batch_finished(const ReceiveBatchFinished& event);
     Observer<PipelineCleanup> obs_pipeline_cleanup;
     void pipeline_cleanup(const PipelineCleanup& event);
+    Observer<PeerRemoved> obs_peer_removed;
+    void peer_removed(const PeerRemoved& event);
+    Observer<PeerIdle> obs_peer_idle;
+    void peer_idle(const PeerIdle& event);
 
-    TransmissionQueue& get_queue(const std::string& id);
+    std::shared_ptr<TransmissionQueue<Handler>> get_queue(uint32_t peer);
+
+    /**
+     * Chave do nó nas estatísticas: o id dele, ou o índice quando não há
+     * GroupRegistry.
+    */
+    std::string stats_key(uint32_t peer);
 
 public:
-    TransmissionLayer(PipelineHandler handler, GroupRegistry *gr);
-    ~TransmissionLayer() override;
+    TransmissionLayer(Handler handler, GroupRegistry *gr, const TransmissionConfig& config);
+    ~TransmissionLayer();
 
     void attach(EventBus&);
 
     void send(Packet packet);
     void receive(Packet packet);
+
+    std::map<std::string, RttStats> get_rtt_stats();
+    std::map<std::string, CongestionStats> get_congestion_stats();
 };
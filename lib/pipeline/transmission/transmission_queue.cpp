@@ -1,54 +1,212 @@
 #include "pipeline/transmission/transmission_queue.h"
+#include "pipeline/protocol_stack.h"
 #include "core/constants.h"
 #include "core/event.h"
+#include "core/trace.h"
 
-TransmissionQueue::TransmissionQueue(Timer& timer, PipelineHandler& handler)
-    : timer(timer), handler(handler)
+template <typename Handler>
+TransmissionQueue<Handler>::TransmissionQueue(
+    Handler& handler,
+    std::shared_ptr<const TransmissionConfig> config
+) :
+    handler(handler),
+    config(config),
+    rtt(config->ack_timeout, config->min_ack_timeout, config->max_ack_timeout),
+    congestion(CongestionController::create(config->congestion_control, WindowLimits{
+        initial : config->initial_congestion_window,
+        min : config->min_congestion_window,
+        max : config->max_congestion_window
+    }))
 {
 }
 
-void TransmissionQueue::send(uint32_t num) {
+template <typename Handler>
+void TransmissionQueue<Handler>::send(uint32_t num) {
     QueueEntry& entry = entries.at(num);
 
-    handler.forward_send(entry.packet);
     entry.tries++;
+    entry.timeout = rtt.get_timeout();
+
+    packets_sent++;
+    if (entry.tries > 1)
+    {
+        retransmissions++;
+        handler.count(entry.packet.meta.peer, Counter::RETRANSMISSIONS);
+    }
 
     pending.emplace(num);
-    entry.timeout_id = timer.add(ACK_TIMEOUT, [this, num]() { timeout(num); });
+    uint32_t msg_num = message_num;
+
+    uint32_t bytes = sizeof(PacketHeader) + entry.packet.meta.message_length;
+    PacingClock::time_point release = pacer.schedule(bytes, get_pacing_rate());
+    int64_t wait = std::chrono::duration_cast<std::chrono::microseconds>(release - PacingClock::now()).count();
+    uint64_t delay = std::max<int64_t>(wait, 0);
+
+    // O timeout só começa a contar quando o pacote de fato sai.
+    entry.timeout_id = timer.add(entry.timeout + (delay + 999) / 1000, [this, msg_num, num]() { timeout(msg_num, num); });
+    entry.sent_at = DateUtils::monotonic_us() + delay;
+
+    if (!delay)
+    {
+        handler.forward_send(entry.packet);
+        return;
+    }
+
+    timer.add_at(release, [this, msg_num, num]() { transmit(msg_num, num); });
 }
 
-void TransmissionQueue::timeout(uint32_t num)
+template <typename Handler>
+void TransmissionQueue<Handler>::transmit(uint32_t msg_num, uint32_t num) {
+    mutex_packets.lock();
+
+    if (msg_num == message_num && pending.contains(num))
+        handler.forward_send(entries.at(num).packet);
+
+    mutex_packets.unlock();
+}
+
+template <typename Handler>
+double TransmissionQueue<Handler>::get_pacing_rate() {
+    double rate = 0;
+
+    if (config->pacing)
+    {
+        RttStats stats = rtt.get_stats();
+
+        // Ganho acima de 1 para que o pacing não impeça a janela de crescer.
+        double gain = congestion->in_slow_start() ? 2 : 1.25;
+
+        if (stats.samples && stats.srtt > 0)
+            rate = gain * congestion->get_window() * PacketData::MAX_PACKET_SIZE / (stats.srtt / 1000);
+    }
+
+    if (config->max_pacing_rate && (!rate || rate > config->max_pacing_rate))
+        rate = config->max_pacing_rate;
+
+    return rate;
+}
+
+template <typename Handler>
+void TransmissionQueue<Handler>::send_available() {
+    if (!receive_window)
+    {
+        schedule_probe();
+        return;
+    }
+
+    uint32_t window = congestion->get_window();
+
+    while (waiting.size() && pending.size() < window) {
+        uint32_t num = waiting.front();
+        waiting.pop_front();
+        send(num);
+    }
+}
+
+template <typename Handler>
+void TransmissionQueue<Handler>::timeout(uint32_t msg_num, uint32_t num)
 {
-    mutex_timeout.lock();
+    mutex_packets.lock();
 
-    if (!entries.contains(num))
+    if (msg_num != message_num || !pending.contains(num))
     {
-        mutex_timeout.unlock();
+        mutex_packets.unlock();
         return;
     };
 
     QueueEntry& entry = entries.at(num);
-    Packet& packet = entry.packet;
+    entry.timeout_id = -1;
+    handler.count(entry.packet.meta.peer, Counter::TIMEOUTS);
 
-    if (entry.tries > MAX_PACKET_TRIES)
+    if (entry.tries > (int) config->max_packet_tries)
     {
-        log_error("Packet [", packet.to_string(PacketFormat::SENT), "] expired. Transmission failed.");
+        Packet packet = entry.packet;
+        log_error("Packet [", packet.summary(PacketFormat::SENT), "] expired. Transmission failed.");
+        Trace::record(TraceEvent::PACKET_EXPIRED, packet);
 
-        handler.notify(TransmissionFail(entry.packet));
+        clear();
 
-        reset();
+        mutex_packets.unlock();
 
-        mutex_timeout.unlock();
+        handler.notify(TransmissionFail(packet));
         return;
     }
 
-    mutex_timeout.unlock();
+    rtt.backoff(entry.timeout);
+    congestion->on_timeout(entry.sent_at);
 
-    log_warn("Packet [", packet.to_string(PacketFormat::SENT), "] timed out. Sending again, already tried ", entry.tries, " time(s).");
+    if (Trace::enabled())
+    {
+        Trace::record(TraceEvent::PACKET_RETRANSMITTED, entry.packet);
+    }
+    else
+    {
+        log_warn("Packet [", entry.packet.summary(PacketFormat::SENT), "] timed out after ", entry.timeout, " ms. Sending again, already tried ", entry.tries, " time(s).");
+    }
     send(num);
+
+    mutex_packets.unlock();
+}
+
+template <typename Handler>
+void TransmissionQueue<Handler>::update_window(uint32_t window) {
+    if (window == Packet::UNKNOWN_WINDOW) return;
+
+    receive_window = window;
+
+    if (!receive_window) return;
+
+    probe_interval = 0;
+    if (probe_timer_id != -1)
+    {
+        timer.cancel(probe_timer_id);
+        probe_timer_id = -1;
+    }
+}
+
+/**
+ * Agenda uma sonda da janela do receptor, caso haja fragmentos aguardando e
+ * nenhum deles esteja em trânsito (que já serviria de sonda).
+*/
+template <typename Handler>
+void TransmissionQueue<Handler>::schedule_probe() {
+    if (probe_timer_id != -1 || !waiting.size() || pending.size()) return;
+
+    probe_interval = probe_interval
+        ? std::min(probe_interval * 2, (uint32_t) MAX_ZERO_WINDOW_PROBE_INTERVAL)
+        : rtt.get_timeout();
+
+    uint32_t msg_num = message_num;
+    probe_timer_id = timer.add(probe_interval, [this, msg_num]() { probe(msg_num); });
+}
+
+template <typename Handler>
+void TransmissionQueue<Handler>::probe(uint32_t msg_num) {
+    mutex_packets.lock();
+
+    probe_timer_id = -1;
+
+    if (msg_num == message_num && waiting.size())
+    {
+        uint32_t num = waiting.front();
+        waiting.pop_front();
+
+        log_debug("Receive window of ", entries.at(num).packet.meta.destination.to_string(), " is zero; probing with fragment ", message_num, "/", num, ".");
+        send(num);
+    }
+
+    mutex_packets.unlock();
+}
+
+template <typename Handler>
+void TransmissionQueue<Handler>::reset() {
+    mutex_packets.lock();
+    clear();
+    mutex_packets.unlock();
 }
 
-void TransmissionQueue::reset() {
+template <typename Handler>
+void TransmissionQueue<Handler>::clear() {
     for (auto& pair : entries) {
         QueueEntry& entry = pair.second;
 
@@ -59,13 +217,21 @@ void TransmissionQueue::reset() {
         }
     }
 
+    if (probe_timer_id != -1)
+    {
+        timer.cancel(probe_timer_id);
+        probe_timer_id = -1;
+    }
+
     pending.clear();
+    waiting.clear();
     entries.clear();
     message_num = UINT32_MAX;
     end_fragment_num = UINT32_MAX;
 }
 
-uint32_t TransmissionQueue::get_total_bytes() {
+template <typename Handler>
+uint32_t TransmissionQueue<Handler>::get_total_bytes() {
     uint32_t sum = 0;
     for (const auto& pair : entries) {
         const QueueEntry& entry = pair.second;
@@ -74,22 +240,34 @@ uint32_t TransmissionQueue::get_total_bytes() {
     return sum;
 }
 
-bool TransmissionQueue::completed()
+template <typename Handler>
+bool TransmissionQueue<Handler>::idle()
+{
+    std::lock_guard<std::mutex> lock(mutex_packets);
+    return entries.empty() && waiting.empty() && probe_timer_id == -1;
+}
+
+template <typename Handler>
+bool TransmissionQueue<Handler>::completed()
 {
-    return !pending.size() && end_fragment_num != UINT32_MAX;
+    return !pending.size() && !waiting.size() && end_fragment_num != UINT32_MAX;
 }
 
-void TransmissionQueue::add_packet(const Packet& packet)
+template <typename Handler>
+void TransmissionQueue<Handler>::add_packet(const Packet& packet)
 {
     uint32_t msg_num = packet.data.header.get_message_number();
     uint32_t num = packet.data.header.get_fragment_number();
 
+    mutex_packets.lock();
+
     if (message_num == UINT32_MAX)
     {
         message_num = msg_num;
     }
     else if (message_num != msg_num)
     {
+        mutex_packets.unlock();
         log_warn(
             "Transmission queue received packet with message number of ",
             msg_num,
@@ -99,52 +277,152 @@ void TransmissionQueue::add_packet(const Packet& packet)
         );
         return;
     }
-    
+
     entries.emplace(num, QueueEntry{packet : packet});
-    send(num);
+    waiting.push_back(num);
 
     if (packet.data.header.is_end())
     {
         end_fragment_num = num;
     }
+
+    send_available();
+
+    mutex_packets.unlock();
 }
 
-void TransmissionQueue::receive_ack(const Packet& ack_packet)
+template <typename Handler>
+void TransmissionQueue<Handler>::receive_ack(const Packet& ack_packet)
 {
-    uint32_t msg_num = ack_packet.data.header.get_message_number();
-    uint32_t frag_num = ack_packet.data.header.get_fragment_number();
+    receive_acks({ack_packet});
+}
 
-    if (msg_num != message_num) return;
+template <typename Handler>
+void TransmissionQueue<Handler>::receive_acks(const std::vector<Packet>& ack_packets)
+{
+    std::vector<int> timeout_ids;
+    uint32_t completed_num = UINT32_MAX;
 
-    if (!entries.contains(frag_num)) return;
-    QueueEntry& entry = entries.at(frag_num);
-    
-    const Packet& packet = entry.packet;
+    mutex_packets.lock();
 
-    if (entry.timeout_id != -1)
+    for (const Packet& ack_packet : ack_packets)
     {
-        log_debug("Cancelling timer of packet ", message_num, "/", frag_num, ".");
-        timer.cancel(entry.timeout_id);
-        entry.timeout_id = -1;
+        uint32_t msg_num = ack_packet.data.header.get_message_number();
+        uint32_t frag_num = ack_packet.data.header.get_fragment_number();
+
+        update_window(ack_packet.get_window());
+
+        if (msg_num != message_num || !pending.contains(frag_num))
+            continue;
+
+        QueueEntry& entry = entries.at(frag_num);
+
+        if (entry.timeout_id != -1)
+        {
+            log_debug("Cancelling timer of packet ", message_num, "/", frag_num, ".");
+            timeout_ids.push_back(entry.timeout_id);
+            entry.timeout_id = -1;
+        }
+
+        // Regra de Karn: o ACK de um pacote retransmitido é ambíguo, então só
+        // pacotes enviados uma única vez geram amostras de RTT.
+        double sample = -1;
+        if (entry.tries == 1)
+        {
+            sample = (DateUtils::monotonic_us() - entry.sent_at) / 1000.0;
+            rtt.add_sample(sample);
+        }
+
+        pending.erase(frag_num);
+        congestion->on_ack(sample);
+
+        if (completed())
+        {
+            completed_num = frag_num;
+            break;
+        }
     }
 
-    pending.erase(frag_num);
+    if (timeout_ids.size())
+        timer.cancel(timeout_ids);
 
-    mutex_timeout.lock();
-    if (completed()) {
-        const UUID& uuid = packet.meta.transmission_uuid;
-        SocketAddress remote_address = packet.meta.destination;
-        uint32_t msg_num = packet.data.header.get_message_number();
-        TransmissionComplete event(uuid, remote_address, msg_num);
+    if (completed_num == UINT32_MAX) {
+        send_available();
+        mutex_packets.unlock();
+        return;
+    }
 
-        log_info(
-            "Transmission ", remote_address.to_string(), " / ", msg_num, " is completed. Sent ",
-            end_fragment_num + 1, " fragments, ", get_total_bytes(), " bytes total."
-        );
+    const Packet& packet = entries.at(completed_num).packet;
+    const UUID& uuid = packet.meta.transmission_uuid;
+    SocketAddress remote_address = packet.meta.destination;
+    TransmissionComplete event(uuid, remote_address, packet.meta.peer, message_num);
+
+    log_info(
+        "Transmission ", remote_address.to_string(), " / ", message_num, " is completed. Sent ",
+        end_fragment_num + 1, " fragments, ", get_total_bytes(), " bytes total."
+    );
+
+    clear();
+
+    mutex_packets.unlock();
+
+    handler.notify(event);
+}
 
-        reset();
+template <typename Handler>
+void TransmissionQueue<Handler>::receive_window_update(const Packet& update_packet)
+{
+    uint32_t msg_num = update_packet.data.header.get_message_number();
+    uint32_t frag_num = update_packet.data.header.get_fragment_number();
+
+    mutex_packets.lock();
+
+    update_window(update_packet.get_window());
+
+    // O fragmento foi recusado por falta de espaço, e não perdido: volta a
+    // aguardar na fila sem contar como tentativa. Recusas sempre anunciam
+    // janela zero; as atualizações espontâneas, com espaço, não se referem a
+    // nenhum fragmento.
+    if (!update_packet.get_window() && msg_num == message_num && pending.contains(frag_num))
+    {
+        QueueEntry& entry = entries.at(frag_num);
+
+        if (entry.timeout_id != -1)
+        {
+            timer.cancel(entry.timeout_id);
+            entry.timeout_id = -1;
+        }
+        entry.tries--;
 
-        handler.notify(event);
+        pending.erase(frag_num);
+        waiting.push_front(frag_num);
     }
-    mutex_timeout.unlock();
+
+    send_available();
+
+    mutex_packets.unlock();
+}
+
+template <typename Handler>
+RttStats TransmissionQueue<Handler>::get_rtt_stats()
+{
+    return rtt.get_stats();
 }
+
+template <typename Handler>
+CongestionStats TransmissionQueue<Handler>::get_congestion_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_packets);
+    return CongestionStats{
+        window : congestion->get_window(),
+        in_flight : (uint32_t) pending.size(),
+        queued : (uint32_t) waiting.size(),
+        pacing_rate : get_pacing_rate(),
+        receive_window : receive_window,
+        packets_sent : packets_sent,
+        retransmissions : retransmissions
+    };
+}
+
+template class TransmissionQueue<PipelineHandler>;
+template class TransmissionQueue<ProtocolHandler<Pipeline::TRANSMISSION_LAYER>>;
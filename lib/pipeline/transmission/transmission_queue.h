@@ -1,49 +1,130 @@
 #pragma once
 
+#include <memory>
 #include <mutex>
 #include <vector>
+#include <deque>
 #include <unordered_set>
 #include <map>
 
 #include "core/packet.h"
 #include "utils/date.h"
 #include "pipeline/pipeline_handler.h"
+#include "pipeline/transmission/rtt_estimator.h"
+#include "pipeline/transmission/congestion_controller.h"
+#include "pipeline/transmission/transmission_config.h"
+#include "pipeline/transmission/pacer.h"
 
 struct QueueEntry {
     Packet packet;
     int timeout_id = -1;
     int tries = 0;
+    uint64_t sent_at = 0;
+    uint32_t timeout = 0;
 };
 
+struct CongestionStats {
+    uint32_t window;
+    uint32_t in_flight;
+    /**
+     * Fragmentos aguardando espaço na janela.
+    */
+    uint32_t queued;
+    double pacing_rate;
+    uint32_t receive_window;
+    uint64_t packets_sent;
+    uint64_t retransmissions;
+};
+
+template <typename Handler>
 class TransmissionQueue
 {
 private:
-    Timer& timer;
-    PipelineHandler& handler;
+    Handler& handler;
+    std::shared_ptr<const TransmissionConfig> config;
 
     std::map<uint32_t, QueueEntry> entries;
 
+    /**
+     * Fragmentos enviados que ainda aguardam ACK.
+    */
     std::unordered_set<uint32_t> pending;
+    /**
+     * Fragmentos que ainda não foram enviados por falta de espaço na janela
+     * de congestionamento, em ordem de envio.
+    */
+    std::deque<uint32_t> waiting;
+
+    RttEstimator rtt;
+    std::unique_ptr<CongestionController> congestion;
+    Pacer pacer;
+
+    /**
+     * Quantas mensagens o receptor anunciou que ainda pode receber. Enquanto
+     * for zero, nenhum fragmento novo é enviado e a janela é sondada
+     * periodicamente.
+    */
+    uint32_t receive_window = Packet::UNKNOWN_WINDOW;
+    uint32_t probe_interval = 0;
+    int probe_timer_id = -1;
+
+    uint64_t packets_sent = 0;
+    uint64_t retransmissions = 0;
 
     uint32_t message_num = UINT32_MAX;
     uint32_t end_fragment_num = UINT32_MAX;
 
     std::mutex mutex_packets;
-    std::mutex mutex_timeout;
 
     void send(uint32_t num);
+    void send_available();
+    void transmit(uint32_t msg_num, uint32_t num);
+
+    double get_pacing_rate();
+
+    void timeout(uint32_t msg_num, uint32_t num);
+
+    void update_window(uint32_t window);
+    void schedule_probe();
+    void probe(uint32_t msg_num);
+
+    void clear();
+
+    /**
+     * Último membro, para ser destruído primeiro: destruir a fila cancela os
+     * timeouts e envios espaçados dela e espera o callback em execução.
+    */
+    Timer timer;
 
-    void timeout(uint32_t num);
 public:
-    TransmissionQueue(Timer& timer, PipelineHandler& handler);
+    TransmissionQueue(
+        Handler& handler,
+        std::shared_ptr<const TransmissionConfig> config
+    );
 
     uint32_t get_total_bytes();
 
     bool completed();
 
+    /**
+     * Nenhum fragmento na fila e nenhuma sondagem agendada: a fila pode ser
+     * descartada sem perder nada além das estimativas de RTT e da janela.
+    */
+    bool idle();
+
     void add_packet(const Packet& packet);
 
     void receive_ack(const Packet& packet);
 
+    /**
+     * Processa vários ACKs com uma única aquisição do lock da fila e um
+     * único cancelamento em lote dos timers confirmados.
+    */
+    void receive_acks(const std::vector<Packet>& packets);
+    void receive_window_update(const Packet& packet);
+
     void reset();
+
+    RttStats get_rtt_stats();
+    CongestionStats get_congestion_stats();
 };
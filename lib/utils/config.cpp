@@ -52,6 +52,12 @@ std::string SocketAddress::to_string() const
     return format("%s:%i", address.to_string().c_str(), port);
 }
 
+std::ostream& operator<<(std::ostream& os, const SocketAddress& address)
+{
+    const IPv4& ip = address.address;
+    return os << int(ip.a) << '.' << int(ip.b) << '.' << int(ip.c) << '.' << int(ip.d) << ':' << address.port;
+}
+
 SocketAddress SocketAddress::from(sockaddr_in& address)
 {
     char remote_address[INET_ADDRSTRLEN];
@@ -60,9 +66,23 @@ SocketAddress SocketAddress::from(sockaddr_in& address)
     return SocketAddress{IPv4::parse(remote_address), remote_port};
 }
 
+static std::string settings_to_string(const Settings &settings)
+{
+    std::string acc;
+    for (const auto &[key, value] : settings)
+    {
+        if (acc.size())
+            acc += ", ";
+        acc += key + " = " + value;
+    }
+    return "{" + acc + "}";
+}
+
 std::string NodeConfig::to_string() const
 {
-    return format("{%s, %s}", id, address.to_string().c_str());
+    if (settings.size())
+        return format("{%s, %s, %s}", id.c_str(), address.to_string().c_str(), settings_to_string(settings).c_str());
+    return format("{%s, %s}", id.c_str(), address.to_string().c_str());
 }
 
 NodeConfig &Config::get_node(std::string id)
@@ -87,6 +107,9 @@ std::string Config::to_string() const
     }
     acc += "};";
 
+    if (options.size())
+        acc += format("\noptions = %s;", settings_to_string(options).c_str());
+
     return acc;
 }
 
@@ -112,11 +135,38 @@ SocketAddress ConfigReader::parse_socket_address()
     return SocketAddress{ip, port};
 }
 
+/**
+ * Lê `{nome = valor, ...}`. Os valores são números ou palavras.
+*/
+Settings ConfigReader::parse_settings()
+{
+    Settings settings;
+
+    expect('{');
+    while (peek() != '}')
+    {
+        std::string key = read_identifier();
+        expect('=');
+        std::string value = read_identifier();
+
+        if (!key.size() || !value.size())
+            throw parse_error(format("Invalid setting at position %i.", get_pos()));
+
+        settings.emplace_back(key, value);
+        if (!read(','))
+            break;
+    }
+    expect('}');
+
+    return settings;
+}
+
 Config ConfigReader::parse()
 {
     reset();
 
     std::vector<NodeConfig> nodes;
+    Settings options;
 
     expect("nodes");
     expect('=');
@@ -135,8 +185,11 @@ Config ConfigReader::parse()
         expect(',');
         SocketAddress address = parse_socket_address();
 
-        NodeConfig node{id, address};
-        nodes.push_back(node);
+        Settings settings;
+        if (read(','))
+            settings = parse_settings();
+
+        nodes.push_back(NodeConfig{id, address, settings});
 
         expect('}');
         read(',');
@@ -144,5 +197,13 @@ Config ConfigReader::parse()
     expect('}');
     expect(';');
 
-    return Config{nodes};
+    if (peek() == 'o')
+    {
+        expect("options");
+        expect('=');
+        options = parse_settings();
+        expect(';');
+    }
+
+    return Config{nodes, options};
 }
@@ -58,16 +58,40 @@ struct SocketAddress
 
     static SocketAddress from(sockaddr_in& address);
 
+    /**
+     * IPv4 e porta em um único inteiro, usado como chave de índices.
+    */
+    uint64_t pack() const
+    {
+        uint32_t ip = (address.a << 24) | (address.b << 16) | (address.c << 8) | address.d;
+        return (uint64_t(ip) << 16) | uint16_t(port);
+    }
+
     bool operator==(const SocketAddress& other) const
     {
         return other.address == address && other.port == port;
     }
 };
 
+/**
+ * Escreve o endereço como SocketAddress::to_string(), sem criar strings.
+*/
+std::ostream& operator<<(std::ostream& os, const SocketAddress& address);
+
+/**
+ * Pares `nome = valor` do nodes.conf, na ordem em que aparecem. Os valores
+ * são interpretados por TransmissionConfig::set().
+*/
+using Settings = std::vector<std::pair<std::string, std::string>>;
+
 struct NodeConfig
 {
     std::string id;
     SocketAddress address;
+    /**
+     * Parâmetros só deste nó, ex.: {2, 10.0.0.2:3000, {ack_timeout = 2000}}.
+    */
+    Settings settings;
 
     std::string to_string() const;
 };
@@ -75,6 +99,11 @@ struct NodeConfig
 struct Config
 {
     std::vector<NodeConfig> nodes;
+    /**
+     * Parâmetros da instância e padrão dos nós, do bloco opcional
+     * `options = { ... };` após os nós.
+    */
+    Settings options;
 
     NodeConfig &get_node(std::string id);
 
@@ -91,5 +120,6 @@ public:
 
     IPv4 parse_ipv4();
     SocketAddress parse_socket_address();
+    Settings parse_settings();
     Config parse();
 };
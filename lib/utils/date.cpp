@@ -1,117 +1,374 @@
 #include "utils/date.h"
 
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+
 
 uint64_t DateUtils::now() {
     return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 }
 
+uint64_t DateUtils::monotonic_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+TimerService& TimerService::instance() {
+    static TimerService service;
+    return service;
+}
+
+TimerService::TimerService() : base(std::chrono::steady_clock::now()) {
+    slots.fill(TimerEntry::NONE);
+    occupied.fill(0);
 
-TimerEntry::TimerEntry(
-    int id,
-    uint64_t date,
-    std::function<void()> callback
-) : id(id), date(date), callback(callback) {}
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
+    if (epoll_fd < 0 || timer_fd < 0 || stop_fd < 0)
+        throw std::runtime_error("Unable to create the timer service descriptors.");
+
+    for (int fd : {timer_fd, stop_fd}) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
 
-Timer::Timer() {
     thread = std::thread([this]() { routine(); });
 }
 
-Timer::~Timer() {
+TimerService::~TimerService() {
+    mutex.lock();
     stop = true;
-    var.notify_all();
-    has_timers_sem.release();
+    mutex.unlock();
+
+    uint64_t value = 1;
+    if (write(stop_fd, &value, sizeof(value)) < 0)
+        log_error("Unable to stop the timer service.");
 
     thread.join();
+
+    close(stop_fd);
+    close(timer_fd);
+    close(epoll_fd);
 }
 
-int Timer::add(int interval_ms, std::function<void()> callback) {
-    uint64_t now = DateUtils::now();
-    uint64_t date = now + interval_ms;
+uint64_t TimerService::now_tick() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - base).count() / TICK_US;
+}
+
+uint32_t TimerService::allocate() {
+    if (free_entries.size()) {
+        uint32_t index = free_entries.back();
+        free_entries.pop_back();
+        return index;
+    }
+
+    if (entries.size() > INDEX_MASK) throw std::runtime_error("Too many active timers.");
+
+    entries.emplace_back();
+    return entries.size() - 1;
+}
+
+void TimerService::release(uint32_t index) {
+    TimerEntry& entry = entries[index];
+
+    if (entry.owner_prev != TimerEntry::NONE) entries[entry.owner_prev].owner_next = entry.owner_next;
+    else entry.owner->first_entry = entry.owner_next;
+
+    if (entry.owner_next != TimerEntry::NONE) entries[entry.owner_next].owner_prev = entry.owner_prev;
+
+    entry.owner = nullptr;
+    entry.owner_prev = TimerEntry::NONE;
+    entry.owner_next = TimerEntry::NONE;
+
+    entry.active = false;
+    entry.callback = nullptr;
+    entry.generation = (entry.generation + 1) & GENERATION_MASK;
+
+    free_entries.push_back(index);
+}
+
+void TimerService::link(uint32_t index) {
+    TimerEntry& entry = entries[index];
+
+    const uint64_t range = 1ull << (SLOT_BITS * LEVELS);
+    uint64_t position = std::min(entry.expires, current_tick + range - 1);
+    uint64_t delta = position - current_tick;
 
-    current_id++;
-    auto timer = std::make_shared<TimerEntry>(current_id, date, callback);
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1)))) level++;
 
-    timers_mutex.lock();
+    uint32_t slot = level * SLOTS + ((position >> (SLOT_BITS * level)) & (SLOTS - 1));
+    uint32_t head = slots[slot];
 
-    size_t insert_i = timers.size();
-    for (int i=timers.size() - 1; i >= 0; i--) {
-        auto& t = timers.at(i);
-        if (t->date < date) break;
+    entry.slot = slot;
+    entry.next = TimerEntry::NONE;
 
-        insert_i = i;
+    if (head == TimerEntry::NONE) {
+        entry.prev = index;
+        slots[slot] = index;
     }
-    // log_debug("Insert timer ", current_id, " scheduled for ", date % 60000, " at pos ", insert_i);
-    timers.insert(timers.begin() + insert_i, timer);
+    else {
+        uint32_t tail = entries[head].prev;
+        entries[tail].next = index;
+        entry.prev = tail;
+        entries[head].prev = index;
+    }
+
+    occupied[slot / 64] |= 1ull << (slot % 64);
+}
 
-    timers_mutex.unlock();
+void TimerService::unlink(uint32_t index) {
+    TimerEntry& entry = entries[index];
+    uint32_t head = slots[entry.slot];
 
-    var.notify_all();
-    has_timers_sem.release();
+    if (index == head) {
+        slots[entry.slot] = entry.next;
+        if (entry.next != TimerEntry::NONE) entries[entry.next].prev = entry.prev;
+    }
+    else {
+        entries[entry.prev].next = entry.next;
+        if (entry.next != TimerEntry::NONE) entries[entry.next].prev = entry.prev;
+        else entries[head].prev = entry.prev;
+    }
+
+    if (slots[entry.slot] == TimerEntry::NONE)
+        occupied[entry.slot / 64] &= ~(1ull << (entry.slot % 64));
 
-    return current_id;
+    entry.slot = TimerEntry::NONE;
+    entry.prev = TimerEntry::NONE;
+    entry.next = TimerEntry::NONE;
 }
 
-bool Timer::cancel(int id) {
-    bool success = false;
+/**
+ * Redistribui os timers da posição atual de um nível superior nos níveis
+ * abaixo dele.
+*/
+void TimerService::cascade(int level) {
+    uint32_t slot = level * SLOTS + ((current_tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+
+    uint32_t index = slots[slot];
+    slots[slot] = TimerEntry::NONE;
+    occupied[slot / 64] &= ~(1ull << (slot % 64));
+
+    while (index != TimerEntry::NONE) {
+        uint32_t next = entries[index].next;
+        link(index);
+        index = next;
+    }
+}
 
-    timers_mutex.lock();
+int TimerService::find_occupied(int level, uint32_t from) {
+    for (uint32_t word = from / 64; word < SLOTS / 64; word++) {
+        uint64_t bits = occupied[level * (SLOTS / 64) + word];
+        if (word == from / 64) bits &= ~0ull << (from % 64);
+        if (bits) return word * 64 + __builtin_ctzll(bits);
+    }
+
+    return -1;
+}
 
-    int size = timers.size();
+/**
+ * Próximo tick em que algo acontece: um slot ocupado do nível 0 vence ou um
+ * slot ocupado de um nível superior precisa de cascade. Níveis vazios são
+ * pulados, então a thread não acorda a cada volta da roda.
+*/
+uint64_t TimerService::next_event_tick() {
+    for (int level = 0; level < LEVELS; level++) {
+        int shift = SLOT_BITS * level;
+        uint64_t rotation = (uint64_t) SLOTS << shift;
+        uint64_t rotation_base = current_tick & ~(rotation - 1);
+        uint32_t index = (current_tick >> shift) & (SLOTS - 1);
+
+        int slot = index + 1 < SLOTS ? find_occupied(level, index + 1) : -1;
+        if (slot >= 0) return rotation_base + ((uint64_t) slot << shift);
+
+        // Slots antes da posição atual só são alcançados na próxima volta.
+        if (find_occupied(level, 0) >= 0) return rotation_base + rotation;
+    }
 
-    for (int i = 0; i < size; i++) {
-        auto timer = timers.at(i);
+    return UINT64_MAX;
+}
 
-        if (timer->id == id) {
-            // log_debug("Cancelled timer ", id);
-            timer->cancelled = true;
-            var.notify_all();
+void TimerService::arm(uint64_t tick) {
+    wake_tick = tick;
 
-            success = true;
-            break;
-        }
+    itimerspec spec{};
+
+    if (tick != UINT64_MAX) {
+        auto when = base + std::chrono::microseconds(tick * TICK_US);
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch()).count();
+
+        spec.it_value.tv_sec = ns / 1000000000;
+        spec.it_value.tv_nsec = ns % 1000000000;
     }
 
-    timers_mutex.unlock();
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+int TimerService::add(Timer* owner, std::chrono::steady_clock::time_point when, std::function<void()> callback) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Sem timers ativos a roda não avança, então ela é trazida para o
+    // presente em vez de percorrer os ticks vazios depois.
+    if (!active_timers) current_tick = std::max(current_tick, now_tick());
+
+    uint32_t index = allocate();
+    TimerEntry& entry = entries[index];
 
-    return success;
+    // Arredonda para cima, para que o timer nunca dispare antes do instante.
+    int64_t offset = std::chrono::duration_cast<std::chrono::microseconds>(when - base).count();
+    uint64_t deadline = (std::max<int64_t>(offset, 0) + TICK_US - 1) / TICK_US;
+
+    entry.expires = std::max(deadline, current_tick + 1);
+    entry.callback = std::move(callback);
+    entry.active = true;
+
+    entry.owner = owner;
+    entry.owner_prev = TimerEntry::NONE;
+    entry.owner_next = owner->first_entry;
+    if (entry.owner_next != TimerEntry::NONE) entries[entry.owner_next].owner_prev = index;
+    owner->first_entry = index;
+
+    link(index);
+    active_timers++;
+
+    if (entry.expires < wake_tick) arm(entry.expires);
+
+    return (entry.generation << INDEX_BITS) | index;
+}
+
+bool TimerService::cancel(Timer* owner, int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cancel_locked(owner, id);
+}
+
+size_t TimerService::cancel(Timer* owner, const std::vector<int>& ids) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t cancelled = 0;
+    for (int id : ids) cancelled += cancel_locked(owner, id);
+    return cancelled;
+}
+
+bool TimerService::cancel_locked(Timer* owner, int id) {
+    if (id < 0) return false;
+
+    uint32_t index = id & INDEX_MASK;
+    uint32_t generation = id >> INDEX_BITS;
+
+    if (index >= entries.size()) return false;
+
+    TimerEntry& entry = entries[index];
+    if (!entry.active || entry.generation != generation || entry.owner != owner) return false;
+
+    unlink(index);
+    release(index);
+    active_timers--;
+
+    return true;
+}
+
+void TimerService::remove(Timer* owner) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (owner->first_entry != TimerEntry::NONE) {
+        uint32_t index = owner->first_entry;
+        unlink(index);
+        release(index);
+        active_timers--;
+    }
+
+    // Um callback pode destruir o próprio Timer; nesse caso não há o que esperar.
+    if (std::this_thread::get_id() != thread.get_id())
+        callback_done.wait(lock, [&]() { return running != owner; });
 }
 
-void Timer::routine() {
+void TimerService::routine() {
+    std::unique_lock<std::mutex> lock(mutex);
+
     while (!stop) {
-        while (!timers.size()) {
-            // log_debug("Waiting for active timer");
-            has_timers_sem.acquire();
+        uint64_t now = now_tick();
 
-            if (stop) return;
-            continue;
-        }
+        while (!stop) {
+            uint64_t next = next_event_tick();
+            if (next > now) break;
 
-        timers_mutex.lock();
+            current_tick = next;
 
-        std::shared_ptr<TimerEntry> next_timer = timers.at(0);
+            for (int level = 1; level < LEVELS; level++) {
+                if ((current_tick >> (SLOT_BITS * (level - 1))) & (SLOTS - 1)) break;
+                cascade(level);
+            }
 
-        uint64_t timer_date = next_timer->date;
-        uint64_t now = DateUtils::now();
-        int interval = timer_date - now;
+            uint32_t slot = current_tick & (SLOTS - 1);
 
-        // log_debug("Next timer is ", next_timer->id, " in ", interval, "ms");
+            while (!stop && slots[slot] != TimerEntry::NONE) {
+                uint32_t index = slots[slot];
+                TimerEntry& entry = entries[index];
 
-        if (interval <= 0 || next_timer->cancelled) {
-            timers.erase(timers.begin());
-            
-            timers_mutex.unlock();
-            
-            // log_debug("Trigerring timer ", next_timer->id, ", time is ", now % 60000);
-            if (!next_timer->cancelled) next_timer->callback();
+                std::function<void()> callback = std::move(entry.callback);
+                running = entry.owner;
 
-            continue;
+                unlink(index);
+                release(index);
+                active_timers--;
+
+                lock.unlock();
+                callback();
+                lock.lock();
+
+                running = nullptr;
+                callback_done.notify_all();
+            }
         }
 
-        timers_mutex.unlock();
+        if (stop) break;
+
+        // Não sobrou nada até `now`, então a roda pode avançar direto.
+        current_tick = std::max(current_tick, now);
+        arm(next_event_tick());
+
+        lock.unlock();
+
+        epoll_event events[2];
+        epoll_wait(epoll_fd, events, 2, -1);
+
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+            log_error("Unable to read the timer service timerfd.");
 
-        // log_debug("Sleeping for ", interval, "ms");
-        std::unique_lock<std::mutex> lock(mutex);
-        var.wait_for(lock, std::chrono::milliseconds(interval));
+        lock.lock();
     }
-}
\ No newline at end of file
+}
+
+
+Timer::Timer() : service(TimerService::instance()) {
+}
+
+Timer::~Timer() {
+    service.remove(this);
+}
+
+int Timer::add(int interval_ms, std::function<void()> callback) {
+    auto when = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(interval_ms, 0));
+    return service.add(this, when, std::move(callback));
+}
+
+int Timer::add_at(std::chrono::steady_clock::time_point when, std::function<void()> callback) {
+    return service.add(this, when, std::move(callback));
+}
+
+bool Timer::cancel(int id) {
+    return service.cancel(this, id);
+}
+
+size_t Timer::cancel(const std::vector<int>& ids) {
+    return service.cancel(this, ids);
+}
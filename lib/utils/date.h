@@ -4,7 +4,10 @@
 #include <thread>
 #include <functional>
 #include <condition_variable>
+#include <mutex>
 #include <memory>
+#include <vector>
+#include <array>
 
 #include "utils/log.h"
 
@@ -12,42 +15,179 @@ class DateUtils
 {
 public:
     static uint64_t now();
+
+    /**
+     * Instante atual em microssegundos de um relógio monotônico. Usado para
+     * medir intervalos (ex.: RTT), nunca para exibir datas.
+    */
+    static uint64_t monotonic_us();
 };
 
 
+class Timer;
+
 struct TimerEntry {
-    int id;
-    uint64_t date;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    uint64_t expires = 0;
     std::function<void()> callback;
-    bool cancelled = false;
 
-    TimerEntry(
-        int id,
-        uint64_t date,
-        std::function<void()> callback
-    );
+    /**
+     * Incrementada sempre que a entrada é reutilizada, para que ids de
+     * timers antigos não cancelem o timer atual.
+    */
+    uint32_t generation = 0;
+    bool active = false;
+
+    /**
+     * Posição na roda. As listas dos slots são FIFO: `prev` da cabeça aponta
+     * para o fim da lista.
+    */
+    uint32_t slot = NONE;
+    uint32_t prev = NONE;
+    uint32_t next = NONE;
+
+    /**
+     * Lista dos timers pendentes de um mesmo Timer, para cancelá-los quando
+     * ele é destruído.
+    */
+    Timer* owner = nullptr;
+    uint32_t owner_prev = NONE;
+    uint32_t owner_next = NONE;
 };
 
 
-class Timer {
-    std::vector<std::shared_ptr<TimerEntry>> timers;
-    std::mutex timers_mutex;
+/**
+ * Serviço de timers compartilhado pelo processo inteiro: uma única thread,
+ * acordada por um timerfd, executa os callbacks de todos os Timers.
+ *
+ * Os timers ficam em uma roda de tempo hierárquica (hierarchical timing
+ * wheel) com resolução de TICK_US microssegundos. Inserir e cancelar um timer
+ * são O(1): cada nível tem SLOTS posições, e os timers que vencem além do
+ * alcance de um nível ficam nos níveis superiores até serem redistribuídos
+ * (cascade) quando o nível abaixo completa uma volta.
+ *
+ * As entradas ficam em um pool reaproveitado e são encadeadas por índice,
+ * sem alocações por timer além do callback.
+ *
+ * Como todos os callbacks do processo dividem a mesma thread, um callback
+ * não pode bloquear nem fazer trabalho longo: enquanto ele roda, nenhuma
+ * retransmissão, sondagem ou expiração dispara. Trabalho que pode bloquear,
+ * como entregar pacotes às camadas de cima, deve ser repassado a outra
+ * thread.
+*/
+class TimerService {
+public:
+    static constexpr uint64_t TICK_US = 100;
+
+private:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 8;
+    static constexpr uint32_t SLOTS = 1 << SLOT_BITS;
+
+    /**
+     * Ids de timer são o índice da entrada no pool nos bits baixos e a
+     * geração da entrada nos bits altos.
+    */
+    static constexpr int INDEX_BITS = 20;
+    static constexpr uint32_t INDEX_MASK = (1 << INDEX_BITS) - 1;
+    static constexpr uint32_t GENERATION_MASK = (1u << (31 - INDEX_BITS)) - 1;
+
+    std::chrono::steady_clock::time_point base;
+    uint64_t current_tick = 0;
+    uint64_t wake_tick = UINT64_MAX;
+
+    std::vector<TimerEntry> entries;
+    std::vector<uint32_t> free_entries;
+    std::array<uint32_t, LEVELS * SLOTS> slots;
+    std::array<uint64_t, LEVELS * SLOTS / 64> occupied;
+    uint32_t active_timers = 0;
 
-    std::binary_semaphore has_timers_sem{0};
     std::mutex mutex;
-    std::condition_variable var;
+
+    /**
+     * Timer cujo callback está executando, para que o destrutor dele espere
+     * o callback terminar.
+    */
+    Timer* running = nullptr;
+    std::condition_variable callback_done;
+
+    int epoll_fd = -1;
+    int timer_fd = -1;
+    int stop_fd = -1;
 
     std::thread thread;
     bool stop = false;
-    int current_id = 0;
+
+    TimerService();
+    ~TimerService();
+
+    uint64_t now_tick();
+
+    uint32_t allocate();
+    void release(uint32_t index);
+
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+
+    bool cancel_locked(Timer* owner, int id);
+
+    void cascade(int level);
+    int find_occupied(int level, uint32_t from);
+    uint64_t next_event_tick();
+    void arm(uint64_t tick);
 
     void routine();
+public:
+    static TimerService& instance();
+
+    TimerService(const TimerService&) = delete;
+    TimerService& operator=(const TimerService&) = delete;
+
+    int add(Timer* owner, std::chrono::steady_clock::time_point when, std::function<void()> callback);
+    bool cancel(Timer* owner, int id);
+    size_t cancel(Timer* owner, const std::vector<int>& ids);
+
+    /**
+     * Cancela todos os timers pendentes de `owner` e espera o callback dele
+     * que estiver executando terminar.
+    */
+    void remove(Timer* owner);
+};
+
+
+/**
+ * Conjunto de timers de um componente. Os timers são executados pelo
+ * TimerService, e os callbacks não devem bloquear; destruir o Timer cancela
+ * os que ainda não dispararam.
+*/
+class Timer {
+    friend class TimerService;
+
+    TimerService& service;
+    uint32_t first_entry = TimerEntry::NONE;
+
 public:
     Timer();
 
     ~Timer();
 
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
     int add(int interval_ms, std::function<void()> callback);
 
+    /**
+     * Agenda o callback para um instante do relógio monotônico, com
+     * precisão de TimerService::TICK_US.
+    */
+    int add_at(std::chrono::steady_clock::time_point when, std::function<void()> callback);
+
     bool cancel(int id);
+
+    /**
+     * Cancela vários timers com uma única aquisição do lock do serviço.
+     * Retorna quantos ainda estavam pendentes.
+    */
+    size_t cancel(const std::vector<int>& ids);
 };
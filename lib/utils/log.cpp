@@ -1,16 +1,292 @@
-
+#include <algorithm>
+#include <condition_variable>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
-#include <unordered_map>
+#include <vector>
 
-std::unordered_map<std::thread::id, int> id_map;
-int counter = 0;
+#include "utils/log.h"
 
 int get_thread_id() {
-    std::thread::id id = std::this_thread::get_id();
+    static std::atomic<int> counter{0};
+    thread_local int id = counter++;
+
+    return id;
+}
+
+namespace log_detail {
+
+void Record::write_arguments(std::ostream& os) const
+{
+    if (overflow)
+    {
+        os << *overflow;
+        return;
+    }
+
+    constexpr std::size_t HEADER = sizeof(Formatter) + sizeof(uint16_t);
+
+    for (std::size_t offset = 0; offset < length;)
+    {
+        Formatter formatter;
+        uint16_t size;
+        memcpy(&formatter, payload + offset, sizeof(Formatter));
+        memcpy(&size, payload + offset + sizeof(Formatter), sizeof(uint16_t));
+
+        formatter(os, payload + offset + HEADER, size);
+        offset += HEADER + size;
+    }
+}
+
+/**
+ * Escreve um registro no formato de sempre. `clock` guarda o último
+ * horário formatado, já que localtime é caro e os registros de um mesmo
+ * segundo chegam juntos.
+*/
+struct Clock {
+    std::time_t second = -1;
+    char text[64] = "";
+};
+
+static void format_record(std::ostream& os, const Record& record, Clock& clock)
+{
+    if (!record.level)
+    {
+        record.write_arguments(os);
+        os << '\n';
+        return;
+    }
 
-    if (!id_map.contains(id)) {
-        id_map.emplace(id, counter++);
+    std::time_t second = std::chrono::system_clock::to_time_t(record.time);
+    if (second != clock.second)
+    {
+        std::tm tm;
+        localtime_r(&second, &tm);
+        std::strftime(clock.text, sizeof(clock.text), BOLD_H_WHITE "%H:%M:%S" COLOR_RESET, &tm);
+        clock.second = second;
     }
 
-    return id_map.at(id);
-}
\ No newline at end of file
+    os << '\r' << clock.text << ' ' << record.level;
+    #if LOG_FILES
+    os << H_BLACK " [" << record.file << ':' << record.line << "]" COLOR_RESET;
+    #endif
+    os << H_BLACK " (" << record.thread_id << ")" COLOR_RESET ": ";
+    record.write_arguments(os);
+    os << '\n';
+}
+
+/**
+ * Dona dos buffers das threads e da thread de log. Nunca é destruída, para
+ * que threads que registram durante o encerramento do processo não usem
+ * um objeto já destruído; o encerramento só para a thread de log.
+*/
+class AsyncLogger
+{
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    std::mutex mutex_buffers;
+
+    std::mutex mutex_wake;
+    std::condition_variable has_work;
+    std::atomic<bool> active{true};
+    bool stop = false;
+    /**
+     * Algum buffer passou da metade desde a última escrita.
+    */
+    bool pending = false;
+
+    /**
+     * Serializa as escritas da thread de log com as de write_now().
+    */
+    std::mutex mutex_output;
+
+    std::thread thread;
+
+    void routine()
+    {
+        std::vector<const Record*> batch;
+        std::vector<std::pair<Buffer*, uint64_t>> consumed;
+        std::vector<std::pair<int, uint64_t>> dropped;
+        std::ostringstream out;
+        Clock clock;
+
+        while (true)
+        {
+            bool stopping;
+            {
+                std::unique_lock lock(mutex_wake);
+                has_work.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL), [this] { return stop || pending; });
+                stopping = stop;
+                pending = false;
+            }
+
+            std::vector<std::shared_ptr<Buffer>> current;
+            mutex_buffers.lock();
+            current = buffers;
+            mutex_buffers.unlock();
+
+            for (const std::shared_ptr<Buffer>& buffer : current)
+            {
+                uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+                uint64_t head = buffer->head.load(std::memory_order_acquire);
+
+                for (uint64_t position = tail; position < head; position++)
+                    batch.push_back(&buffer->records[position % LOG_BUFFER_RECORDS]);
+                consumed.emplace_back(buffer.get(), head);
+
+                uint64_t lost = buffer->dropped.exchange(0, std::memory_order_relaxed);
+                if (lost) dropped.emplace_back(buffer->thread_id, lost);
+            }
+
+            // Registros de threads diferentes saem em ordem de horário; os de
+            // uma mesma thread já estão em ordem e a ordenação é estável.
+            std::stable_sort(batch.begin(), batch.end(), [](const Record* a, const Record* b) {
+                return a->time < b->time;
+            });
+
+            for (const Record* record : batch)
+                format_record(out, *record, clock);
+
+            for (auto& [thread_id, lost] : dropped)
+                out << '\r' << LABEL_WARN << H_BLACK " (" << thread_id << ")" COLOR_RESET ": Log buffer full; dropped " << lost << " message(s).\n";
+
+            for (auto& [buffer, head] : consumed)
+                buffer->tail.store(head, std::memory_order_release);
+
+            std::string text = out.str();
+            if (!text.empty())
+            {
+                mutex_output.lock();
+                std::cout.write(text.data(), text.size());
+                std::cout.flush();
+                mutex_output.unlock();
+            }
+
+            out.str("");
+            batch.clear();
+            consumed.clear();
+            dropped.clear();
+
+            release_closed_buffers();
+
+            if (stopping) break;
+        }
+    }
+
+    void release_closed_buffers()
+    {
+        std::lock_guard lock(mutex_buffers);
+
+        std::erase_if(buffers, [](const std::shared_ptr<Buffer>& buffer) {
+            return buffer->closed.load(std::memory_order_acquire)
+                && buffer->tail.load(std::memory_order_relaxed) == buffer->head.load(std::memory_order_acquire);
+        });
+    }
+
+public:
+    AsyncLogger() : thread(&AsyncLogger::routine, this) {}
+
+    static AsyncLogger& instance()
+    {
+        static AsyncLogger* logger = new AsyncLogger;
+        return *logger;
+    }
+
+    std::shared_ptr<Buffer> create_buffer()
+    {
+        std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>();
+        buffer->thread_id = get_thread_id();
+
+        std::lock_guard lock(mutex_buffers);
+        buffers.push_back(buffer);
+        return buffer;
+    }
+
+    bool is_active()
+    {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    void wake()
+    {
+        mutex_wake.lock();
+        pending = true;
+        mutex_wake.unlock();
+        has_work.notify_one();
+    }
+
+    void shutdown()
+    {
+        if (!active.exchange(false))
+            return;
+
+        mutex_wake.lock();
+        stop = true;
+        mutex_wake.unlock();
+        has_work.notify_one();
+
+        if (thread.joinable()) thread.join();
+    }
+
+    void write(const Record& record)
+    {
+        std::ostringstream out;
+        Clock clock;
+        format_record(out, record, clock);
+        std::string text = out.str();
+
+        std::lock_guard lock(mutex_output);
+        std::cout.write(text.data(), text.size());
+        std::cout.flush();
+    }
+};
+
+/**
+ * Marca o buffer como encerrado quando a thread termina; a thread de log o
+ * descarta depois de escrever o que restou nele.
+*/
+struct ThreadBuffer {
+    std::shared_ptr<Buffer> buffer = AsyncLogger::instance().create_buffer();
+
+    ~ThreadBuffer()
+    {
+        buffer->closed.store(true, std::memory_order_release);
+    }
+};
+
+Buffer& thread_buffer()
+{
+    thread_local ThreadBuffer local;
+    return *local.buffer;
+}
+
+bool running()
+{
+    return AsyncLogger::instance().is_active();
+}
+
+void wake()
+{
+    AsyncLogger::instance().wake();
+}
+
+void write_now(const Record& record)
+{
+    AsyncLogger::instance().write(record);
+}
+
+/**
+ * Escreve os registros pendentes quando o processo termina normalmente.
+*/
+static struct ShutdownOnExit {
+    ~ShutdownOnExit() { Logger::shutdown(); }
+} shutdown_on_exit;
+
+}
+
+void Logger::shutdown()
+{
+    log_detail::AsyncLogger::instance().shutdown();
+}
@@ -1,9 +1,16 @@
 #pragma once
 
-#include <iomanip>
-#include <iostream>
-#include <mutex>
-#include <thread>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 #include "utils/format.h"
 #include "utils/ansi.h"
@@ -16,6 +23,20 @@
 #define LOG_LEVEL 2
 #endif
 
+/**
+ * Registros que cada thread pode ter pendentes antes de começar a descartar.
+*/
+#ifndef LOG_BUFFER_RECORDS
+#define LOG_BUFFER_RECORDS 1024
+#endif
+
+/**
+ * Intervalo máximo, em ms, entre duas escritas da thread de log.
+*/
+#ifndef LOG_FLUSH_INTERVAL
+#define LOG_FLUSH_INTERVAL 10
+#endif
+
 
 #define LABEL_ERROR RED "ERROR" COLOR_RESET
 #define LABEL_WARN YELLOW "WARN" COLOR_RESET
@@ -61,49 +82,260 @@
 int get_thread_id();
 
 
-static std::mutex log_mutex;
+namespace log_detail {
+    using Formatter = void (*)(std::ostream&, const char* data, uint16_t size);
+
+    /**
+     * Uma chamada de log com os argumentos capturados, ainda sem formatar.
+     * Cada argumento ocupa, em `payload`, o formatador dele, o tamanho e os
+     * bytes: texto é copiado, e valores trivialmente copiáveis (números,
+     * endereços, PacketSummary) são copiados como estão e só passam pelo
+     * operator<< na thread de log.
+    */
+    struct Record {
+        static constexpr uint16_t PAYLOAD_SIZE = 240;
+
+        /**
+         * nullptr para linhas de log_print, que saem sem prefixo.
+        */
+        const char* level;
+        const char* file;
+        int line;
+        int thread_id;
+        std::chrono::system_clock::time_point time;
+
+        uint16_t length;
+        bool truncated;
+        char payload[PAYLOAD_SIZE];
+        /**
+         * Linha inteira, já formatada, quando os argumentos não cabem em
+         * `payload`.
+        */
+        std::unique_ptr<std::string> overflow;
+
+        void append(Formatter formatter, const void* data, std::size_t size, bool is_text)
+        {
+            constexpr std::size_t HEADER = sizeof(Formatter) + sizeof(uint16_t);
+
+            std::size_t used = length + HEADER;
+            std::size_t available = used < PAYLOAD_SIZE ? PAYLOAD_SIZE - used : 0;
+            if (size > available)
+            {
+                truncated = true;
+                if (!is_text || !available) return;
+                size = available;
+            }
+
+            uint16_t size16 = size;
+            memcpy(payload + length, &formatter, sizeof(Formatter));
+            memcpy(payload + length + sizeof(Formatter), &size16, sizeof(uint16_t));
+            memcpy(payload + length + HEADER, data, size);
+            length += HEADER + size;
+        }
+
+        /**
+         * Escreve os argumentos em `os`, na ordem em que foram capturados.
+        */
+        void write_arguments(std::ostream& os) const;
+    };
+
+    inline void format_text(std::ostream& os, const char* data, uint16_t size)
+    {
+        os.write(data, size);
+    }
+
+    template <typename T>
+    void format_value(std::ostream& os, const char* data, uint16_t)
+    {
+        std::array<char, sizeof(T)> bytes;
+        memcpy(bytes.data(), data, sizeof(T));
+        os << std::bit_cast<T>(bytes);
+    }
+
+    /**
+     * Formata o argumento como a thread de log faria com o que capture()
+     * guardou.
+    */
+    template <typename T>
+    void write_eager(std::ostream& os, const T& value)
+    {
+        if constexpr (std::is_pointer_v<T> && std::is_convertible_v<const T&, std::string_view>)
+            os << (value ? value : "(null)");
+        else
+            os << value;
+    }
+
+    template <typename T>
+    void capture(Record& record, const T& value)
+    {
+        using Value = std::decay_t<T>;
+
+        if constexpr (std::is_convertible_v<const T&, std::string_view>)
+        {
+            std::string_view text;
+            if constexpr (std::is_pointer_v<T>)
+                text = value ? std::string_view(value) : std::string_view("(null)");
+            else
+                text = value;
+
+            record.append(&format_text, text.data(), text.size(), true);
+        }
+        else if constexpr (std::is_trivially_copyable_v<Value> && !std::is_array_v<T>)
+        {
+            record.append(&format_value<Value>, &value, sizeof(Value), false);
+        }
+        else
+        {
+            // Tipos que não podem ser copiados byte a byte são formatados aqui
+            // mesmo, na thread que registra.
+            std::ostringstream oss;
+            oss << value;
+            std::string text = oss.str();
+            record.append(&format_text, text.data(), text.size(), true);
+        }
+    }
+
+    /**
+     * Fila de registros de uma única thread (um produtor, a própria thread,
+     * e um consumidor, a thread de log), sem locks. Quando está cheia, o
+     * registro novo é descartado e contado em `dropped`.
+    */
+    struct Buffer {
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+        alignas(64) std::atomic<uint64_t> dropped{0};
+
+        /**
+         * A thread dona terminou; o buffer é descartado depois de esvaziado.
+        */
+        std::atomic<bool> closed{false};
+        int thread_id = 0;
+
+        std::array<Record, LOG_BUFFER_RECORDS> records;
+
+        Record* begin_write()
+        {
+            uint64_t position = head.load(std::memory_order_relaxed);
+            if (position - tail.load(std::memory_order_acquire) >= LOG_BUFFER_RECORDS)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Record* record = &records[position % LOG_BUFFER_RECORDS];
+            record->length = 0;
+            record->truncated = false;
+            record->overflow.reset();
+            record->thread_id = thread_id;
+            return record;
+        }
+
+        /**
+         * Publica o registro. Retorna true quando o buffer passou da metade,
+         * para que a thread de log seja acordada antes do intervalo.
+        */
+        bool end_write()
+        {
+            uint64_t position = head.load(std::memory_order_relaxed) + 1;
+            head.store(position, std::memory_order_release);
+            return position - tail.load(std::memory_order_relaxed) == LOG_BUFFER_RECORDS / 2;
+        }
+    };
+
+    /**
+     * Buffer da thread atual, criado e registrado no primeiro log dela.
+    */
+    Buffer& thread_buffer();
+
+    /**
+     * Se a thread de log ainda está ativa. Depois de Logger::shutdown() os
+     * registros são escritos diretamente, com write_now().
+    */
+    bool running();
+
+    /**
+     * Acorda a thread de log antes do fim do intervalo.
+    */
+    void wake();
+
+    /**
+     * Formata e escreve um registro na saída imediatamente, com um lock.
+    */
+    void write_now(const Record& record);
+}
+
 
+/**
+ * Log assíncrono. A chamada só copia os argumentos para o buffer da
+ * própria thread, sem lock, sem alocação (para texto, números e tipos
+ * trivialmente copiáveis) e sem formatação; uma thread de fundo esvazia os
+ * buffers a cada LOG_FLUSH_INTERVAL ms, formata os registros em ordem de
+ * horário e os escreve em std::cout de uma vez.
+ *
+ * Se a thread de log não acompanhar, os registros de uma thread com o
+ * buffer cheio são descartados, e a quantidade descartada é informada no
+ * próprio log. No encerramento do processo os registros pendentes são
+ * escritos, e a partir daí o log passa a ser síncrono.
+*/
 class Logger
 {
+    template <typename... Args>
+    static void submit(const char *level, const char *file, int line, Args &&...args)
+    {
+        log_detail::Record local;
+        log_detail::Buffer* buffer = nullptr;
+        log_detail::Record* record = &local;
+
+        if (log_detail::running())
+        {
+            buffer = &log_detail::thread_buffer();
+            record = buffer->begin_write();
+            if (!record) return;
+        }
+        else
+        {
+            local.length = 0;
+            local.truncated = false;
+            local.thread_id = get_thread_id();
+        }
+
+        record->level = level;
+        record->file = file;
+        record->line = line;
+        record->time = std::chrono::system_clock::now();
+        (log_detail::capture(*record, args), ...);
+
+        if (record->truncated)
+        {
+            // Linhas maiores que o registro são formatadas aqui mesmo, sem
+            // cortar; é o caso raro, então a alocação é aceitável.
+            std::ostringstream text;
+            (log_detail::write_eager(text, args), ...);
+            record->overflow = std::make_unique<std::string>(text.str());
+        }
+
+        if (!buffer)
+            log_detail::write_now(local);
+        else if (buffer->end_write())
+            log_detail::wake();
+    }
+
 public:
     template <typename... Args>
     static void log(const char *level, [[maybe_unused]] const char *file, [[maybe_unused]] int line, Args &&...args)
     {
-        log_mutex.lock();
-        auto t = std::time(nullptr);
-        auto tm = *std::localtime(&t);
-        int thread_id = get_thread_id();
-
-        std::ostringstream oss;
-
-        (oss
-        << '\r'
-        << std::put_time(&tm, BOLD_H_WHITE "%H:%M:%S" COLOR_RESET)
-        << format(" %s", level)
-        #if LOG_FILES
-        << format(H_BLACK " [%s:%i]" COLOR_RESET, file, line)
-        #endif
-        << format(H_BLACK " (%u)" COLOR_RESET, thread_id)
-        << ": "
-        << ...
-        << args)
-        << std::endl;
-
-        std::cout << oss.str();
-
-        log_mutex.unlock();
+        submit(level, file, line, std::forward<Args>(args)...);
     }
 
     template <typename... Args>
     static void print([[maybe_unused]] std::string prefix, Args &&...args)
     {
-        log_mutex.lock();
-
-        std::ostringstream oss;
-
-        (oss << ... << args) << std::endl;
-        std::cout << oss.str();
-
-        log_mutex.unlock();
+        submit(nullptr, nullptr, 0, std::forward<Args>(args)...);
     }
+
+    /**
+     * Escreve tudo o que já foi registrado e encerra a thread de log. Os
+     * logs seguintes são escritos diretamente.
+    */
+    static void shutdown();
 };
@@ -23,6 +23,10 @@ class Subject {
 public:
 
     ~Subject() {
+        clear();
+    }
+
+    void clear() {
         for (int i = observers.size() - 1; i >= 0; i--) {
             pop_observer(i);
         }
@@ -156,6 +156,22 @@ std::string Reader::read_word()
     return str.substr(start, pos - start);
 }
 
+std::string Reader::read_identifier()
+{
+    char ch = peek();
+    int start = pos;
+
+    Override ovr = override_whitespace(false);
+
+    while (ch && (isalnum(ch) || ch == '_'))
+    {
+        advance();
+        ch = peek();
+    }
+
+    return str.substr(start, pos - start);
+}
+
 void Reader::consume_space()
 {
     while (peek() && isspace(peek()))
@@ -56,6 +56,10 @@ public:
     char read(char ch);
     int read_int();
     std::string read_word();
+    /**
+     * Como read_word(), aceitando também '_'.
+    */
+    std::string read_identifier();
 
     void consume_space();
 
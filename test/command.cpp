@@ -18,6 +18,11 @@ DummyCommand::DummyCommand(size_t size, std::string send_id)
 
 std::string DummyCommand::name() { return "dummy"; }
 
+BenchCommand::BenchCommand(size_t size, size_t count, size_t depth, std::string send_id)
+    : Command(CommandType::bench), size(size), count(count), depth(depth), send_id(send_id) {}
+
+std::string BenchCommand::name() { return "bench"; }
+
 FileCommand::FileCommand(std::string path, std::string send_id)
     : Command(CommandType::file), path(path), send_id(send_id)  {}
 
@@ -94,6 +99,14 @@ std::shared_ptr<Command> parse_command(Reader& reader) {
         std::string send_id = parse_destination(reader);
         return std::make_shared<DummyCommand>(size, send_id);
     }
+    if (keyword == "bench") {
+        int size = reader.read_int();
+        int count = reader.read_int();
+        int depth = isdigit(reader.peek()) ? reader.read_int() : 1;
+
+        std::string send_id = parse_destination(reader);
+        return std::make_shared<BenchCommand>(size, count, depth, send_id);
+    }
 
     if (keyword.length()) {
         throw std::invalid_argument(
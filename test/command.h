@@ -6,7 +6,8 @@
 enum CommandType {
     text = 0,
     file = 1,
-    dummy = 2
+    dummy = 2,
+    bench = 3
 };
 
 struct Command {
@@ -35,6 +36,20 @@ struct DummyCommand : public Command {
     virtual std::string name();
 };
 
+struct BenchCommand : public Command {
+    size_t size;
+    size_t count;
+    /**
+     * Quantas mensagens ficam em andamento ao mesmo tempo.
+    */
+    size_t depth;
+    std::string send_id;
+
+    BenchCommand(size_t size, size_t count, size_t depth, std::string send_id);
+
+    virtual std::string name();
+};
+
 struct FileCommand : public Command {
     std::string path;
     std::string send_id;
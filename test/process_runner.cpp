@@ -1,11 +1,15 @@
 // process_runner.cpp
 
 #include <sys/stat.h>
+#include <array>
+#include <deque>
+#include <future>
 
 #include "process_runner.h"
 #include "utils/log.h"
 #include "core/node.h"
 #include "core/constants.h"
+#include "core/trace.h"
 #include "utils/format.h"
 #include "communication/reliable_communication.h"
 #include "utils/reader.h"
@@ -14,6 +18,7 @@
 #include "command.h"
 
 const std::size_t BUFFER_SIZE = Message::MAX_SIZE;
+const std::size_t SERVER_BATCH_SIZE = 16;
 
 std::string get_available_flags(const char* program_name) {
     std::string result;
@@ -25,12 +30,23 @@ std::string get_available_flags(const char* program_name) {
     result += YELLOW "  text " H_BLACK "<" WHITE "message" H_BLACK ">" COLOR_RESET " -> " H_BLACK "<" WHITE "id" H_BLACK ">" COLOR_RESET ": Send a message to the node with id <id>.\n";
     result += YELLOW "  file " H_BLACK "<" WHITE "path" H_BLACK ">" COLOR_RESET " -> " H_BLACK "<" WHITE "id" H_BLACK ">" COLOR_RESET ": Send a file to the node with id <id>.\n";
     result += YELLOW "  dummy " H_BLACK "<" WHITE "size" H_BLACK ">" COLOR_RESET " -> " H_BLACK "<" WHITE "id" H_BLACK ">" COLOR_RESET ": Send a dummy message of size <size> to the node with id <id>.\n";
+    result += YELLOW "  bench " H_BLACK "<" WHITE "size" H_BLACK "> <" WHITE "count" H_BLACK "> [" WHITE "depth" H_BLACK "]" COLOR_RESET " -> " H_BLACK "<" WHITE "id" H_BLACK ">" COLOR_RESET ": Send <count> dummy messages of size <size>, <depth> at a time (default 1), and report goodput and retransmit rate.\n";
+    result += YELLOW "  stats: " COLOR_RESET "Show the RTT estimates, congestion window and counters of each node, and the time spent in each layer.\n";
+    result += YELLOW "  reload: " COLOR_RESET "Re-read nodes.conf, adding and removing nodes without restarting.\n";
     result += YELLOW "  help: " COLOR_RESET "Show the help message.\n";
     result += YELLOW "  exit: " COLOR_RESET "Terminates the process.\n";
 
     result += BOLD_CYAN "\nAvailable flags:\n" COLOR_RESET;
     result += YELLOW "  -s " H_BLACK "'" WHITE "<commands>" H_BLACK "'" COLOR_RESET ": Executes commands at process start.\n";
     result += YELLOW "  -f " H_BLACK "<" WHITE "fault-list" H_BLACK ">" COLOR_RESET ": Defines faults for packet reception based on a fault list.\n";
+    result += YELLOW "  -d " H_BLACK "[" WHITE "min" H_BLACK ", " WHITE "max" H_BLACK "]" COLOR_RESET ": Range in ms of the random delay applied to each received packet.\n";
+    result += YELLOW "  -b " H_BLACK "<" WHITE "bytes/s" H_BLACK ">" COLOR_RESET ": Limits the bandwidth of the simulated link on packet reception.\n";
+    result += YELLOW "  -q " H_BLACK "<" WHITE "packets" H_BLACK ">" COLOR_RESET ": Queue size of the simulated link (default 16).\n";
+    result += YELLOW "  -p " H_BLACK "<" WHITE "bytes/s" H_BLACK ">" COLOR_RESET ": Caps the pacing rate of each connection.\n";
+    result += YELLOW "  -c " H_BLACK "<" WHITE "newreno|vegas" H_BLACK ">" COLOR_RESET ": Congestion control algorithm.\n";
+    result += YELLOW "  -t " H_BLACK "<" WHITE "threads" H_BLACK ">" COLOR_RESET ": Number of sender worker threads.\n";
+    result += YELLOW "  -w " H_BLACK "<" WHITE "ms" H_BLACK ">" COLOR_RESET ": Waits after each received message, simulating a slow consumer.\n";
+    result += YELLOW "  -r " H_BLACK "<" WHITE "path" H_BLACK ">" COLOR_RESET ": Records a binary packet trace to <path> instead of logging each packet.\n";
 
     return result;
 }
@@ -65,9 +81,23 @@ std::vector<int> parse_fault_list(Reader& reader) {
     return values;
 }
 
+CongestionControl parse_congestion_control(Reader& reader) {
+    std::string name = reader.read_word();
+
+    if (name == "newreno") return CongestionControl::NEW_RENO;
+    if (name == "vegas") return CongestionControl::VEGAS;
+
+    throw std::invalid_argument(
+        format("Unknown congestion control '%s' at pos %i", name.c_str(), reader.get_pos() - name.length())
+    );
+}
+
 Arguments parse_arguments(int argc, char* argv[]) {
-    std::vector<int> faults;
+    FaultConfig fault;
+    TransmissionConfig transmission;
+    int consume_delay = 0;
     std::vector<std::shared_ptr<Command>> send_commands;
+    std::string trace_path;
 
     std::string value;
     for (int i=1; i < argc; i++) {
@@ -105,11 +135,38 @@ Arguments parse_arguments(int argc, char* argv[]) {
         );
 
         if (flag == "f") {
-            faults = parse_fault_list(reader);
+            fault.faults = parse_fault_list(reader);
+        }
+        else if (flag == "d") {
+            std::vector<int> range = parse_fault_list(reader);
+            if (range.size() != 2) throw std::invalid_argument("Delay range must have exactly two values.");
+            fault.min_delay = range[0];
+            fault.max_delay = range[1];
+        }
+        else if (flag == "b") {
+            fault.bandwidth = reader.read_int();
+        }
+        else if (flag == "q") {
+            fault.link_queue_size = reader.read_int();
+        }
+        else if (flag == "p") {
+            transmission.max_pacing_rate = reader.read_int();
+        }
+        else if (flag == "t") {
+            transmission.sender_workers = reader.read_int();
+        }
+        else if (flag == "w") {
+            consume_delay = reader.read_int();
+        }
+        else if (flag == "c") {
+            transmission.congestion_control = parse_congestion_control(reader);
         }
         else if (flag == "s") {
             send_commands = parse_commands(reader);
         }
+        else if (flag == "r") {
+            trace_path = parse_path(reader);
+        }
         else {
             throw std::invalid_argument(
                 format("Unknown flag '%s' at pos %i", flag.c_str(), reader.get_pos() - flag.length())
@@ -117,7 +174,7 @@ Arguments parse_arguments(int argc, char* argv[]) {
         }
     }
 
-    return Arguments{node_id, faults, send_commands};
+    return Arguments{node_id, fault, transmission, consume_delay, send_commands, trace_path};
 }
 
 
@@ -145,6 +202,49 @@ void create_dummy_data(char* data, size_t size) {
     }
 } 
 
+bool run_bench(ReliableCommunication* comm, BenchCommand* cmd) {
+    std::unique_ptr<char[]> data = std::make_unique<char[]>(cmd->size);
+    create_dummy_data(data.get(), cmd->size);
+
+    CongestionStats before = comm->get_congestion_stats()[cmd->send_id];
+    uint64_t start = DateUtils::monotonic_us();
+
+    size_t delivered = 0;
+    if (cmd->depth <= 1) {
+        for (size_t i = 0; i < cmd->count; i++) {
+            if (comm->send(cmd->send_id, {data.get(), cmd->size})) delivered++;
+        }
+    }
+    else {
+        std::deque<std::future<bool>> in_flight;
+        for (size_t i = 0; i < cmd->count; i++) {
+            if (in_flight.size() >= cmd->depth) {
+                if (in_flight.front().get()) delivered++;
+                in_flight.pop_front();
+            }
+            in_flight.push_back(comm->send_async(cmd->send_id, {data.get(), cmd->size}));
+        }
+        for (std::future<bool>& result : in_flight) {
+            if (result.get()) delivered++;
+        }
+    }
+
+    double elapsed = (DateUtils::monotonic_us() - start) / 1000000.0;
+    CongestionStats after = comm->get_congestion_stats()[cmd->send_id];
+
+    uint64_t packets = after.packets_sent - before.packets_sent;
+    uint64_t retransmissions = after.retransmissions - before.retransmissions;
+
+    log_print(
+        "Delivered ", delivered, "/", cmd->count, " messages of ", cmd->size, " bytes in ",
+        format("%.2f", elapsed), " s. Goodput: ", format("%.1f", delivered * cmd->size / elapsed / 1024), " KB/s. ",
+        "Retransmitted ", retransmissions, " of ", packets, " packets (",
+        format("%.1f", packets ? 100.0 * retransmissions / packets : 0), "%)."
+    );
+
+    return delivered == cmd->count;
+}
+
 struct SenderThreadArgs {
     ReliableCommunication* comm;
     std::shared_ptr<Command> command;
@@ -183,6 +283,14 @@ void send_thread(SenderThreadArgs* args) {
 
             success = comm->send(send_id, {data.get(), size});
         }
+        else if (command->type == CommandType::bench) {
+            BenchCommand* cmd = static_cast<BenchCommand*>(command.get());
+            send_id = cmd->send_id;
+
+            log_info("Executing command '", cmd->name(), "', sending ", cmd->count, " messages of ", cmd->size, " bytes to node ", send_id, ".");
+
+            success = run_bench(comm, cmd);
+        }
         else if (command->type == CommandType::file) {
             FileCommand* cmd = static_cast<FileCommand*>(command.get());
 
@@ -233,25 +341,65 @@ void parallelize(ReliableCommunication& comm, const std::vector<std::shared_ptr<
 
 void server(ThreadArgs* args) {
     ReliableCommunication* comm = args->communication;
-    char buffer[BUFFER_SIZE];
+    std::array<ReceivedMessage, SERVER_BATCH_SIZE> messages;
+
     while (true) {
-        ReceiveResult result;
+        std::size_t count;
         try {
-            result = comm->receive(buffer);
+            count = comm->receive_many(messages, std::chrono::milliseconds(1000));
         }
         catch (buffer_termination& err) {
             return;
         }
-        
-        if (result.length == 0) break;
-        log_print("Received '", std::string(buffer, result.length).c_str(), "' (", result.length, " bytes) from ", result.sender_id);
 
-        mkdir("messages", S_IRWXU);
-        std::string output_filename = "messages/" + UUID().as_string();
-        std::ofstream file(output_filename);
-        file.write(buffer, result.length);
-        log_print("Saved message to file [", output_filename, "].");
+        for (std::size_t i = 0; i < count; i++) {
+            ReceivedMessage message = std::move(messages[i]);
+
+            if (message.length() == 0) return;
+            log_print("Received '", std::string(message.data(), message.length()).c_str(), "' (", message.length(), " bytes) from ", message.sender_id);
+
+            mkdir("messages", S_IRWXU);
+            std::string output_filename = "messages/" + UUID().as_string();
+            std::ofstream file(output_filename);
+            file.write(message.data(), message.length());
+            log_print("Saved message to file [", output_filename, "].");
+
+            if (args->consume_delay)
+                std::this_thread::sleep_for(std::chrono::milliseconds(args->consume_delay));
+        }
+    }
+}
+
+void print_stats(ReliableCommunication& comm) {
+    std::map<std::string, CongestionStats> congestion = comm.get_congestion_stats();
+
+    for (auto& [id, rtt] : comm.get_rtt_stats()) {
+        CongestionStats& cc = congestion[id];
+        log_print(
+            "Node ", id, ": srtt ", format("%.2f", rtt.srtt), " ms, rttvar ", format("%.2f", rtt.rttvar),
+            " ms, rto ", rtt.rto, " ms (", rtt.samples, " samples); window ", cc.window,
+            ", in flight ", cc.in_flight, ", receive window ", cc.receive_window, ", pacing ", format("%.1f", cc.pacing_rate / 1024), " KB/s, ", cc.retransmissions, "/", cc.packets_sent, " packets retransmitted."
+        );
+    }
+
+    CommunicationStats stats = comm.stats();
 
+    for (auto& [id, peer] : stats.peers) {
+        log_print(
+            "Node ", id, ": sent ", peer.packets_sent, " packets (", peer.bytes_sent, " bytes), received ", peer.packets_received,
+            " packets (", peer.bytes_received, " bytes), queued ", peer.queued_messages, " messages and ", peer.queued_fragments, " fragments."
+        );
+        log_print(
+            "Node ", id, ": ", peer.retransmissions, " retransmissions, ", peer.timeouts, " timeouts, ", peer.duplicate_fragments,
+            " duplicate fragments, ", peer.checksum_failures, " checksum failures, ", peer.reorder_drops, " reorder drops, ",
+            peer.buffer_full_drops, " buffer full drops."
+        );
+    }
+    for (LayerStats& layer : stats.layers) {
+        log_print(
+            "Layer ", layer.name, ": send ", format("%.3f", layer.send_ns / 1e6), " ms in ", layer.send_calls, " calls, receive ",
+            format("%.3f", layer.receive_ns / 1e6), " ms in ", layer.receive_calls, " calls."
+        );
     }
 }
 
@@ -267,6 +415,19 @@ void client(ReliableCommunication& comm) {
             std::cout << get_available_flags("program") << std::endl;
             continue;
         }
+        if (input == "stats") {
+            print_stats(comm);
+            continue;
+        }
+        if (input == "reload") {
+            try {
+                comm.reload_nodes();
+            }
+            catch (const std::exception& err) {
+                log_error("Unable to reload nodes: ", err.what());
+            }
+            continue;
+        }
 
         std::vector<std::shared_ptr<Command>> commands;
 
@@ -289,8 +450,11 @@ void client(ReliableCommunication& comm) {
 }
 
 void run_process(const Arguments& args) {
-    FaultConfig fault = { faults : args.faults };
-    ReliableCommunication comm(args.node_id, BUFFER_SIZE, fault);
+    if (args.trace_path.length() && !Trace::open(args.trace_path)) throw std::invalid_argument(
+        format("Unable to record trace to %s.", args.trace_path.c_str())
+    );
+
+    ReliableCommunication comm(args.node_id, BUFFER_SIZE, args.fault, args.transmission);
 
     try {
         Node local_node = comm.get_group_registry()->get_local_node();
@@ -299,7 +463,7 @@ void run_process(const Arguments& args) {
         throw std::invalid_argument("Nodo não encontrado no registro.");
     }
 
-    ThreadArgs targs = { &comm };
+    ThreadArgs targs = { &comm, args.consume_delay };
 
     std::thread server_thread(server, &targs);
 
@@ -309,4 +473,6 @@ void run_process(const Arguments& args) {
 
     comm.shutdown();
     server_thread.join();
+
+    Trace::close();
 }
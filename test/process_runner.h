@@ -9,14 +9,18 @@
 
 struct Arguments {
     std::string node_id;
-    std::vector<int> faults;
+    FaultConfig fault;
+    TransmissionConfig transmission;
+    int consume_delay = 0;
     std::vector<std::shared_ptr<Command>> send_commands;
+    std::string trace_path;
 };
 
 Arguments parse_arguments(int argc, char* argv[]);
 
 struct ThreadArgs {
     ReliableCommunication* communication{};
+    int consume_delay = 0;
 };
 
 void server(ThreadArgs* args);
@@ -0,0 +1,60 @@
+// bench_buffer.cpp
+//
+// Mede a vazão do Buffer<T> sob disputa: N produtores e N consumidores
+// movem juntos um total fixo de itens, com capacidades diferentes.
+//
+// Uso: ./build/bin/bench_buffer [itens]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "core/buffer.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Retorna milhões de operações (produção + consumo de um item) por segundo.
+*/
+static double run(int threads, uint32_t capacity, uint64_t items)
+{
+    Buffer<uint64_t> buffer("bench", capacity);
+    uint64_t per_thread = items / threads;
+
+    std::vector<std::thread> workers;
+    Clock::time_point start = Clock::now();
+
+    for (int i = 0; i < threads; i++)
+    {
+        workers.emplace_back([&buffer, per_thread] {
+            for (uint64_t n = 0; n < per_thread; n++)
+                buffer.produce(n);
+        });
+        workers.emplace_back([&buffer, per_thread] {
+            for (uint64_t n = 0; n < per_thread; n++)
+                buffer.consume();
+        });
+    }
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return per_thread * threads / seconds / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t items = argc > 1 ? strtoull(argv[1], nullptr, 10) : 400000;
+
+    printf("%llu uint64_t items, Mops/s\n", (unsigned long long) items);
+    printf("threads   cap 100   cap 1024\n");
+
+    for (int threads : {1, 2, 4, 8, 16})
+        printf("%2d+%-2d     %7.1f   %8.1f\n", threads, threads, run(threads, 100, items), run(threads, 1024, items));
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+// bench_event_bus.cpp
+//
+// Mede o custo de notificar eventos pelo EventBus com muitas conexões
+// abertas. TransmissionComplete é observado uma vez e entregue à conexão
+// do par pelo índice, como faz o GroupRegistry; a versão antiga, em que
+// cada conexão observava o evento e filtrava pelo endereço, é medida ao
+// lado. PacketAckReceived tem um único observador, como no TransmissionLayer.
+//
+// Uso: ./build/bin/bench_event_bus [conexões] [notificações]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+
+#include "core/event_bus.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Substitui a Connection: guarda o próprio endereço e conta as entregas.
+*/
+struct FakeConnection {
+    UUID uuid;
+    SocketAddress address;
+    uint64_t completed = 0;
+
+    void transmission_complete(const TransmissionComplete& event)
+    {
+        if (event.uuid == uuid) completed++;
+    }
+};
+
+static SocketAddress address_of(int i)
+{
+    return SocketAddress{.address = IPv4{.a = 10, .b = 0, .c = uint8_t(i >> 8), .d = uint8_t(i)}, .port = 3000};
+}
+
+static double elapsed_ns(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+static std::vector<TransmissionComplete> make_events(const std::vector<std::shared_ptr<FakeConnection>>& connections)
+{
+    std::vector<TransmissionComplete> events;
+    for (size_t i = 0; i < connections.size(); i++)
+        events.emplace_back(connections[i]->uuid, connections[i]->address, i, 0);
+    return events;
+}
+
+/**
+ * Um observador no barramento resolve a conexão pelo índice do par sob um
+ * shared_lock, como GroupRegistry::find_connection.
+*/
+static void bench_routed(const std::vector<std::shared_ptr<FakeConnection>>& connections, int notifications)
+{
+    std::shared_mutex mutex;
+    EventBus bus;
+
+    Observer<TransmissionComplete> observer([&](const TransmissionComplete& event) {
+        std::shared_ptr<FakeConnection> connection;
+        {
+            std::shared_lock lock(mutex);
+            if (event.peer() < connections.size()) connection = connections[event.peer()];
+        }
+        if (connection) connection->transmission_complete(event);
+    });
+    bus.attach(observer);
+
+    std::vector<TransmissionComplete> events = make_events(connections);
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < notifications; i++)
+        bus.notify(events[i % events.size()]);
+    double total = elapsed_ns(start);
+
+    printf("TransmissionComplete, routed by peer index: %.1f ns/notify\n", total / notifications);
+}
+
+/**
+ * Cada conexão observa o evento e descarta os que não são do seu endereço.
+*/
+static void bench_fan_out(const std::vector<std::shared_ptr<FakeConnection>>& connections, int notifications)
+{
+    EventBus bus;
+
+    std::vector<std::unique_ptr<Observer<TransmissionComplete>>> observers;
+    for (const std::shared_ptr<FakeConnection>& connection : connections)
+    {
+        FakeConnection* target = connection.get();
+        observers.push_back(std::make_unique<Observer<TransmissionComplete>>([target](const TransmissionComplete& event) {
+            if (event.remote_address.pack() == target->address.pack())
+                target->transmission_complete(event);
+        }));
+        bus.attach(*observers.back());
+    }
+
+    std::vector<TransmissionComplete> events = make_events(connections);
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < notifications; i++)
+        bus.notify(events[i % events.size()]);
+    double total = elapsed_ns(start);
+
+    printf("TransmissionComplete, fan-out to every connection: %.1f ns/notify\n", total / notifications);
+}
+
+static void bench_ack(int notifications)
+{
+    EventBus bus;
+    uint64_t acks = 0;
+
+    Observer<PacketAckReceived> observer([&acks](const PacketAckReceived&) { acks++; });
+    bus.attach(observer);
+
+    Packet packet;
+    PacketAckReceived event(packet);
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < notifications; i++)
+        bus.notify(event);
+    double total = elapsed_ns(start);
+
+    printf("PacketAckReceived, one observer: %.1f ns/notify (%llu acks)\n", total / notifications, (unsigned long long) acks);
+}
+
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 100;
+    int notifications = argc > 2 ? atoi(argv[2]) : 1000000;
+
+    std::vector<std::shared_ptr<FakeConnection>> connections;
+    for (int i = 0; i < count; i++)
+    {
+        connections.push_back(std::make_shared<FakeConnection>());
+        connections.back()->address = address_of(i);
+    }
+
+    printf("%d connections\n", count);
+    bench_routed(connections, notifications);
+    bench_fan_out(connections, notifications / 10);
+    bench_ack(notifications * 10);
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+// bench_node_lookup.cpp
+//
+// Mede a identificação da origem de pacotes recebidos em um grupo grande.
+// O benchmark escreve um nodes.conf com vários nós em um diretório
+// temporário e monta um GroupRegistry a partir dele. Cada pacote faz o
+// carimbo do canal (find_peer), a checagem de grupo e duas resoluções da
+// origem pelo índice, como o caminho de recepção. A busca linear sobre a
+// lista de nós, usada antes do índice por endereço, é medida ao lado.
+//
+// Uso: ./build/bin/bench_node_lookup [nós] [pacotes]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
+#include <vector>
+
+#include "communication/group_registry.h"
+
+using Clock = std::chrono::steady_clock;
+
+static SocketAddress address_of(int i)
+{
+    return SocketAddress{.address = IPv4{.a = 10, .b = 0, .c = uint8_t(i >> 8), .d = uint8_t(i)}, .port = 3000 + i % 7};
+}
+
+/**
+ * Cria um diretório temporário com um nodes.conf de `count` nós e entra nele.
+*/
+static std::string enter_group_directory(int count)
+{
+    char path[] = "/tmp/bench_node_lookup.XXXXXX";
+    if (!mkdtemp(path) || chdir(path))
+    {
+        perror("bench_node_lookup");
+        exit(1);
+    }
+
+    std::ofstream conf("nodes.conf");
+    conf << "nodes = {\n";
+    for (int i = 0; i < count; i++)
+        conf << "    {" << i << ", " << address_of(i).to_string() << "},\n";
+    conf << "};\n";
+
+    return path;
+}
+
+static double elapsed_ns(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+static void bench_indexed(GroupRegistry& gr, std::vector<Packet>& received, int packets)
+{
+    uint64_t known = 0;
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < packets; i++)
+    {
+        Packet& packet = received[i % received.size()];
+
+        packet.meta.peer = gr.find_peer(packet.meta.origin);
+        if (!gr.packet_originates_from_group(packet)) continue;
+
+        const Node& sender = gr.get_peer(packet.meta.peer);
+        const Node& owner = gr.get_peer(packet.meta.peer);
+        known += &sender == &owner;
+    }
+    double total = elapsed_ns(start);
+
+    printf("address index: %.1f ns/packet (%llu from the group)\n", total / packets, (unsigned long long) known);
+}
+
+static void bench_linear(GroupRegistry& gr, const std::vector<Packet>& received, int packets)
+{
+    std::vector<Node> nodes = gr.get_nodes();
+    uint64_t known = 0;
+
+    auto find = [&nodes](const SocketAddress& address) -> const Node* {
+        for (const Node& node : nodes)
+            if (node.get_address() == address) return &node;
+        return nullptr;
+    };
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < packets; i++)
+    {
+        const Packet& packet = received[i % received.size()];
+
+        if (!find(packet.meta.origin)) continue;
+
+        const Node* sender = find(packet.meta.origin);
+        const Node* owner = find(packet.meta.origin);
+        known += sender == owner;
+    }
+    double total = elapsed_ns(start);
+
+    printf("linear scan:   %.1f ns/packet (%llu from the group)\n", total / packets, (unsigned long long) known);
+}
+
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 1000;
+    int packets = argc > 2 ? atoi(argv[2]) : 200000;
+
+    std::string directory = enter_group_directory(count);
+    GroupRegistry gr("0");
+
+    std::vector<Packet> received(4096);
+    for (size_t i = 0; i < received.size(); i++)
+        received[i].meta.origin = address_of((i * 7919) % count);
+
+    printf("%d nodes, %d received packets\n", count, packets);
+    bench_indexed(gr, received, packets);
+    bench_linear(gr, received, packets / 100);
+
+    unlink("nodes.conf");
+    rmdir(directory.c_str());
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+// bench_peer_state.cpp
+//
+// Compara as duas formas de guardar estado por nó: mapas indexados por
+// strings (id ou endereço formatado) e vetores indexados pelo índice denso
+// do nó. Cada pacote faz o que o caminho de recepção faz com esse estado:
+// procura a fila de transmissão, insere na remontagem (as mensagens têm 8
+// fragmentos e a remontagem é apagada no último), procura a conexão e
+// procura o nó. Os contêineres e travas seguem os membros de
+// TransmissionLayer, FragmentationLayer e GroupRegistry.
+//
+// Uso: ./build/bin/bench_peer_state [nós] [pacotes]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Queue { uint64_t packets = 0; };
+struct Assembly { uint32_t fragments = 0; };
+struct Connection { uint64_t packets = 0; };
+struct Node { std::string id; std::string address; };
+
+/**
+ * Forma antiga: tudo indexado pelo id ou pelo endereço em texto.
+*/
+struct StringKeyed {
+    std::mutex mutex_queues;
+    std::unordered_map<std::string, std::shared_ptr<Queue>> queues;
+    std::mutex mutex_assemblers;
+    std::unordered_map<std::string, Assembly> assemblers;
+    std::shared_mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Connection>> connections;
+    std::vector<Node> nodes;
+
+    uint64_t handle(uint32_t peer, uint32_t msg_num, bool last)
+    {
+        const std::string& address = nodes[peer].address;
+
+        std::shared_ptr<Queue> queue;
+        {
+            std::lock_guard lock(mutex_queues);
+            std::shared_ptr<Queue>& slot = queues[address];
+            if (!slot) slot = std::make_shared<Queue>();
+            queue = slot;
+        }
+        queue->packets++;
+
+        {
+            std::string key = address + "/" + std::to_string(msg_num);
+            std::lock_guard lock(mutex_assemblers);
+            assemblers[key].fragments++;
+            if (last) assemblers.erase(key);
+        }
+
+        std::shared_lock lock(mutex);
+        const Node* node = nullptr;
+        for (const Node& candidate : nodes)
+            if (candidate.address == address) { node = &candidate; break; }
+        std::shared_ptr<Connection> connection = connections.at(node->id);
+        return ++connection->packets;
+    }
+};
+
+/**
+ * Forma atual: vetores indexados pelo índice do nó.
+*/
+struct DenseIndex {
+    struct Peer {
+        std::shared_ptr<const Node> node;
+        std::shared_ptr<Connection> connection;
+    };
+
+    std::mutex mutex_queues;
+    std::vector<std::shared_ptr<Queue>> queues;
+    std::mutex mutex_assemblers;
+    std::vector<std::unordered_map<uint32_t, Assembly>> assemblers;
+    std::shared_mutex mutex;
+    std::vector<Peer> peers;
+
+    uint64_t handle(uint32_t peer, uint32_t msg_num, bool last)
+    {
+        std::shared_ptr<Queue> queue;
+        {
+            std::lock_guard lock(mutex_queues);
+            if (peer >= queues.size()) queues.resize(peer + 1);
+            std::shared_ptr<Queue>& slot = queues[peer];
+            if (!slot) slot = std::make_shared<Queue>();
+            queue = slot;
+        }
+        queue->packets++;
+
+        {
+            std::lock_guard lock(mutex_assemblers);
+            if (peer >= assemblers.size()) assemblers.resize(peer + 1);
+            assemblers[peer][msg_num].fragments++;
+            if (last) assemblers[peer].erase(msg_num);
+        }
+
+        std::shared_ptr<Connection> connection;
+        {
+            std::shared_lock lock(mutex);
+            connection = peers[peer].connection;
+        }
+        std::shared_lock lock(mutex);
+        const Node& node = *peers[peer].node;
+        return ++connection->packets + node.id.size();
+    }
+};
+
+template <typename State>
+static double run(State& state, const std::vector<uint32_t>& origins, int packets)
+{
+    uint64_t sink = 0;
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < packets; i++)
+        sink += state.handle(origins[(i / 8) % origins.size()], i / 8, i % 8 == 7);
+    double total = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    if (!sink) printf("\n");
+    return total / packets;
+}
+
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 500;
+    int packets = argc > 2 ? atoi(argv[2]) : 1000000;
+
+    StringKeyed string_keyed;
+    DenseIndex dense;
+    for (int i = 0; i < count; i++)
+    {
+        Node node = {
+            .id = std::to_string(i),
+            .address = "10.0." + std::to_string(i >> 8) + "." + std::to_string(i & 0xff) + ":3000",
+        };
+
+        string_keyed.nodes.push_back(node);
+        string_keyed.connections[node.id] = std::make_shared<Connection>();
+        dense.peers.push_back({std::make_shared<const Node>(node), std::make_shared<Connection>()});
+    }
+
+    std::mt19937 random(11);
+    std::uniform_int_distribution<uint32_t> peer(0, count - 1);
+    std::vector<uint32_t> origins(8192);
+    for (uint32_t& origin : origins)
+        origin = peer(random);
+
+    printf("%d peers, %d packets\n", count, packets);
+    printf("string-keyed: %.1f ns/packet\n", run(string_keyed, origins, packets));
+    printf("dense index:  %.1f ns/packet\n", run(dense, origins, packets));
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+// bench_pipeline.cpp
+//
+// Mede a passagem de um pacote pela pilha de camadas: uma camada final que
+// só conta os pacotes e 4 camadas que só repassam. O Pipeline resolve a
+// camada pelo índice e chama send por um método virtual; o StaticPipeline
+// chama a vizinha pelo tipo concreto.
+//
+// Uso: ./build/bin/bench_pipeline [pacotes]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "pipeline/pipeline.h"
+#include "pipeline/static_pipeline.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ns(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+template <typename Handler>
+class Sink : public PipelineLayer<Handler>
+{
+public:
+    uint64_t packets = 0;
+
+    Sink(Handler handler) : PipelineLayer<Handler>(handler, nullptr) {}
+
+    void send(Packet) override { packets++; }
+};
+
+/**
+ * Nada sai da camada mais alta: os pacotes só descem.
+*/
+struct NullTop
+{
+    void receive(Packet&) {}
+    void receive(MessageHandle&) {}
+};
+
+class StaticStack;
+
+template <int I>
+using StaticStackHandler = StaticHandler<StaticStack, I>;
+
+class StaticStack : public StaticPipeline<
+    StaticStack,
+    NullTop,
+    Sink<StaticStackHandler<0>>,
+    PipelineLayer<StaticStackHandler<1>>,
+    PipelineLayer<StaticStackHandler<2>>,
+    PipelineLayer<StaticStackHandler<3>>,
+    PipelineLayer<StaticStackHandler<4>>
+>
+{
+public:
+    StaticStack(EventBus& event_bus, Counters& counters) : StaticPipeline(event_bus, counters, NullTop())
+    {
+        create<4>(nullptr);
+        create<3>(nullptr);
+        create<2>(nullptr);
+        create<1>(nullptr);
+        create<0>();
+        attach_layers();
+    }
+};
+
+/**
+ * Só as 5 medições de tempo por camada que as duas pilhas fazem, aninhadas
+ * como na passagem do pacote.
+*/
+static void time_layers(Counters& counters, int layer)
+{
+    Counters::LayerScope scope(counters, layer, false);
+    if (layer > 0) time_layers(counters, layer - 1);
+}
+
+int main(int argc, char* argv[])
+{
+    int packets = argc > 1 ? atoi(argv[1]) : 2000000;
+
+    Packet packet;
+    packet.meta.message_length = 64;
+
+    Sink<PipelineHandler>* runtime_sink = nullptr;
+    std::vector<Pipeline::LayerFactory> factories = {
+        [&](PipelineHandler handler) { return runtime_sink = new Sink<PipelineHandler>(handler); },
+    };
+    for (int i = 1; i <= 4; i++)
+        factories.push_back([](PipelineHandler handler) { return new PipelineLayer<PipelineHandler>(handler, nullptr); });
+    Pipeline runtime(nullptr, factories);
+
+    EventBus event_bus;
+    Counters counters;
+    StaticStack stack(event_bus, counters);
+
+    printf("%d packets through a sink and 4 pass-through layers, ns/packet\n", packets);
+    printf("round   runtime    static   layer timing only\n");
+
+    for (int round = 1; round <= 3; round++)
+    {
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < packets; i++)
+            runtime.send(packet);
+        double runtime_ns = elapsed_ns(start) / packets;
+
+        start = Clock::now();
+        for (int i = 0; i < packets; i++)
+            stack.send(packet);
+        double static_ns = elapsed_ns(start) / packets;
+
+        start = Clock::now();
+        for (int i = 0; i < packets; i++)
+            time_layers(counters, 4);
+        double timing_ns = elapsed_ns(start) / packets;
+
+        printf("%5d   %7.1f   %7.1f   %17.1f\n", round, runtime_ns, static_ns, timing_ns);
+    }
+
+    uint64_t delivered = runtime_sink->packets + stack.layer<0>().packets;
+    printf("%llu packets delivered\n", (unsigned long long) delivered);
+
+    return 0;
+}
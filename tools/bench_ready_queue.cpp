@@ -0,0 +1,137 @@
+// bench_ready_queue.cpp
+//
+// Mede a ReadyQueue usada pelo SenderPool: o custo de agendar e consumir
+// conexões em uma única thread e a passagem de uma conexão agendada para
+// uma thread consumidora adormecida (ping-pong).
+//
+// Uso: ./build/bin/bench_ready_queue [conexões] [rodadas]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "core/ready_queue.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Substitui a Connection: só o gancho e um contador de atualizações.
+*/
+struct Item {
+    ReadyHook<Item> ready_hook;
+    uint64_t updates = 0;
+};
+
+using Queue = ReadyQueue<Item, &Item::ready_hook>;
+
+static double elapsed_ns(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+/**
+ * Agenda todos os itens, consome cada um, "atualiza" e finaliza.
+*/
+static void bench_schedule_consume(int count, int rounds)
+{
+    Queue queue("bench");
+    std::vector<Item> items(count);
+
+    Clock::time_point start = Clock::now();
+    for (int round = 0; round < rounds; round++)
+    {
+        for (Item& item : items)
+            queue.schedule(&item);
+
+        while (Item* item = queue.try_consume())
+        {
+            item->updates++;
+            queue.finish(item);
+        }
+    }
+    double total = elapsed_ns(start);
+
+    printf("%d items: schedule + consume + finish %.1f ns/item\n", count, total / ((double) count * rounds));
+}
+
+/**
+ * Uma thread agenda um item e espera a consumidora, que dorme em um futex
+ * como os workers do SenderPool, terminar de processá-lo.
+*/
+static void bench_handoff(int rounds)
+{
+    Queue queue("bench");
+    Item item;
+
+    std::atomic<uint32_t> event{0};
+    std::atomic<bool> sleeping{false};
+    std::atomic<uint32_t> done{0};
+    std::atomic<bool> stop{false};
+
+    std::thread consumer([&] {
+        while (!stop)
+        {
+            Item* next = queue.try_consume();
+            if (!next)
+            {
+                uint32_t observed = event.load();
+                sleeping = true;
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                next = queue.try_consume();
+                if (!next)
+                {
+                    if (!stop) event.wait(observed);
+                    sleeping = false;
+                    continue;
+                }
+                sleeping = false;
+            }
+
+            next->updates++;
+            queue.finish(next);
+            done.fetch_add(1);
+            done.notify_one();
+        }
+    });
+
+    Clock::time_point start = Clock::now();
+    for (int round = 0; round < rounds; round++)
+    {
+        uint32_t expected = done.load();
+
+        if (queue.schedule(&item))
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping.exchange(false))
+            {
+                event.fetch_add(1);
+                event.notify_one();
+            }
+        }
+
+        done.wait(expected);
+    }
+    double total = elapsed_ns(start);
+
+    stop = true;
+    event.fetch_add(1);
+    event.notify_one();
+    consumer.join();
+
+    printf("handoff to a sleeping consumer (ping-pong): %.2f us/round trip\n", total / rounds / 1000);
+}
+
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 50;
+    int rounds = argc > 2 ? atoi(argv[2]) : 100000;
+
+    bench_schedule_consume(count, rounds);
+    bench_handoff(rounds / 10);
+
+    return 0;
+}
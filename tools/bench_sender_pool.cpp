@@ -0,0 +1,136 @@
+// bench_sender_pool.cpp
+//
+// Mede a vazão agregada de um nó enviando para vários pares ao mesmo tempo,
+// variando a quantidade de workers do SenderPool. Todos os nós rodam neste
+// processo, em portas de loopback, com o atraso da FaultInjectionLayer
+// desligado. O benchmark escreve o nodes.conf em um diretório temporário,
+// com portas novas a cada rodada para que pacotes de uma rodada não
+// cheguem às conexões da seguinte.
+//
+// Uso: ./build/bin/bench_sender_pool [pares] [mensagens por par] [bytes]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "communication/reliable_communication.h"
+
+using Clock = std::chrono::steady_clock;
+
+#define BENCH_BASE_PORT 41000
+
+/**
+ * Cria um diretório temporário e entra nele.
+*/
+static std::string enter_temporary_directory()
+{
+    char path[] = "/tmp/bench_sender_pool.XXXXXX";
+    if (!mkdtemp(path) || chdir(path))
+    {
+        perror("bench_sender_pool");
+        exit(1);
+    }
+    return path;
+}
+
+static void write_nodes(int count, int base_port)
+{
+    std::ofstream conf("nodes.conf");
+    conf << "nodes = {\n";
+    for (int i = 0; i < count; i++)
+        conf << "    {" << i << ", 127.0.0.1:" << base_port + i << "},\n";
+    conf << "};\n";
+}
+
+static FaultConfig no_delay()
+{
+    FaultConfig config;
+    config.min_delay = 0;
+    config.max_delay = 0;
+    return config;
+}
+
+/**
+ * Um round: o nó 0, com `workers` workers, envia `messages` mensagens de
+ * `size` bytes para cada um dos `peers` pares. Uma mensagem por par, antes
+ * de medir, estabelece as conexões. Retorna MB/s entregues.
+*/
+static double run(int workers, int peers, int messages, int size)
+{
+    TransmissionConfig config;
+    config.sender_workers = workers;
+
+    ReliableCommunication sender("0", size, no_delay(), config);
+
+    std::vector<std::unique_ptr<ReliableCommunication>> receivers;
+    std::vector<std::thread> readers;
+    for (int peer = 1; peer <= peers; peer++)
+        receivers.push_back(std::make_unique<ReliableCommunication>(std::to_string(peer), size, no_delay()));
+
+    for (std::unique_ptr<ReliableCommunication>& receiver : receivers)
+    {
+        ReliableCommunication* comm = receiver.get();
+        readers.emplace_back([comm, messages] {
+            for (int i = 0; i <= messages; i++)
+                comm->receive();
+        });
+    }
+
+    std::vector<char> data(size, 'x');
+    std::vector<OutgoingMessage> batch;
+
+    for (int peer = 1; peer <= peers; peer++)
+        batch.emplace_back(std::to_string(peer), MessageData(data.data(), 1));
+    sender.send_many(batch).get();
+    batch.clear();
+
+    for (int i = 0; i < messages; i++)
+        for (int peer = 1; peer <= peers; peer++)
+            batch.emplace_back(std::to_string(peer), MessageData(data.data(), data.size()));
+
+    Clock::time_point start = Clock::now();
+    std::vector<bool> results = sender.send_many(batch).get();
+    for (std::thread& reader : readers)
+        reader.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    int failed = 0;
+    for (bool ok : results)
+        failed += !ok;
+    if (failed) printf("  %d messages failed\n", failed);
+
+    for (std::unique_ptr<ReliableCommunication>& receiver : receivers)
+        receiver->shutdown();
+    sender.shutdown();
+
+    return (double) peers * messages * size / seconds / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+    int peers = argc > 1 ? atoi(argv[1]) : 8;
+    int messages = argc > 2 ? atoi(argv[2]) : 30;
+    int size = argc > 3 ? atoi(argv[3]) : 4000;
+
+    std::string directory = enter_temporary_directory();
+    int round = 0;
+
+    printf("%d peers, %d messages of %d bytes each, no fault delay\n", peers, messages, size);
+    printf("workers   MB/s\n");
+    for (int workers : {1, 2, 4, 8})
+    {
+        write_nodes(peers + 1, BENCH_BASE_PORT + round++ * (peers + 1));
+        printf("%7d   %6.2f\n", workers, run(workers, peers, messages, size));
+    }
+
+    unlink("nodes.conf");
+    rmdir(directory.c_str());
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+// bench_timer.cpp
+//
+// Mede o custo de agendar e cancelar timers com muitos timers pendentes ao
+// mesmo tempo e a precisão dos disparos do TimerService.
+//
+// Uso: ./build/bin/bench_timer [timers] [disparos]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "utils/date.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_us(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+/**
+ * Agenda `count` timers entre 5 e 10 s, que não chegam a disparar, e os
+ * cancela em ordem aleatória.
+*/
+static void bench_add_cancel(int count)
+{
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> interval(5000, 10000);
+
+    Timer timer;
+    std::vector<int> ids;
+    ids.reserve(count);
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < count; i++)
+        ids.push_back(timer.add(interval(random), [] {}));
+    double add_us = elapsed_us(start);
+
+    std::shuffle(ids.begin(), ids.end(), random);
+
+    start = Clock::now();
+    for (int id : ids)
+        timer.cancel(id);
+    double cancel_us = elapsed_us(start);
+
+    printf("%d concurrent timers: add %.3f us/op, cancel %.3f us/op\n", count, add_us / count, cancel_us / count);
+}
+
+/**
+ * Agenda `count` timers entre 1 e 300 ms e compara o horário de cada
+ * disparo com o pedido.
+*/
+static void bench_accuracy(int count)
+{
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> interval(1, 300);
+
+    std::mutex mutex;
+    std::vector<double> lateness;
+    lateness.reserve(count);
+    std::atomic<int> fired{0};
+
+    Timer timer;
+    for (int i = 0; i < count; i++)
+    {
+        int ms = interval(random);
+        Clock::time_point due = Clock::now() + std::chrono::milliseconds(ms);
+
+        timer.add(ms, [&, due] {
+            double late = std::chrono::duration<double, std::milli>(Clock::now() - due).count();
+            mutex.lock();
+            lateness.push_back(late);
+            mutex.unlock();
+            fired++;
+        });
+    }
+
+    while (fired < count)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    int early = 0;
+    double total = 0, worst = 0;
+    for (double late : lateness)
+    {
+        if (late < 0) early++;
+        total += late;
+        worst = std::max(worst, late);
+    }
+
+    printf("%d timers of 1-300 ms: %d fired early, lateness mean %.3f ms, max %.3f ms\n", count, early, total / count, worst);
+}
+
+int main(int argc, char* argv[])
+{
+    int timers = argc > 1 ? atoi(argv[1]) : 100000;
+    int firings = argc > 2 ? atoi(argv[2]) : 2000;
+
+    bench_add_cancel(timers);
+    bench_accuracy(firings);
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+// trace_decoder.cpp
+//
+// Lê um trace binário gravado com `program <id> -r <arquivo>` e o exibe
+// como texto ou CSV, em ordem de horário.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "core/trace.h"
+
+static void print_usage(const char* program_name)
+{
+    fprintf(stderr, "Usage: %s <trace-file> [--csv]\n", program_name);
+}
+
+static bool read_trace(const char* path, std::vector<TraceRecord>& records)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        fprintf(stderr, "Unable to open %s.\n", path);
+        return false;
+    }
+
+    char raw_header[sizeof(TraceHeader)];
+    if (!file.read(raw_header, sizeof(raw_header)))
+    {
+        fprintf(stderr, "%s is too short to be a trace.\n", path);
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version, record_size;
+    uint64_t capacity, next;
+    memcpy(magic, raw_header + offsetof(TraceHeader, magic), sizeof(magic));
+    memcpy(&version, raw_header + offsetof(TraceHeader, version), sizeof(version));
+    memcpy(&record_size, raw_header + offsetof(TraceHeader, record_size), sizeof(record_size));
+    memcpy(&capacity, raw_header + offsetof(TraceHeader, capacity), sizeof(capacity));
+    memcpy(&next, raw_header + offsetof(TraceHeader, next), sizeof(next));
+
+    if (memcmp(magic, TraceHeader::MAGIC, sizeof(magic)) || version != TraceHeader::VERSION || record_size != sizeof(TraceRecord))
+    {
+        fprintf(stderr, "%s is not a trace of a supported version.\n", path);
+        return false;
+    }
+
+    uint64_t count = std::min(next, capacity);
+    records.resize(capacity);
+    file.read(reinterpret_cast<char*>(records.data()), capacity * sizeof(TraceRecord));
+    records.resize(file.gcount() / sizeof(TraceRecord));
+
+    // Posições ainda não escritas (ou sendo escritas quando o processo
+    // terminou) têm horário zero.
+    std::erase_if(records, [](const TraceRecord& record) { return record.timestamp == 0; });
+
+    if (next > capacity)
+        fprintf(stderr, "Trace wrapped around; showing the last %lu of %lu records.\n", count, next);
+
+    std::stable_sort(records.begin(), records.end(), [](const TraceRecord& a, const TraceRecord& b) {
+        return a.timestamp < b.timestamp;
+    });
+    return true;
+}
+
+static void print_text(const TraceRecord& record)
+{
+    std::time_t second = record.timestamp / 1000000000;
+    std::tm tm;
+    localtime_r(&second, &tm);
+
+    char time[16];
+    std::strftime(time, sizeof(time), "%H:%M:%S", &tm);
+
+    printf("%s.%06lu (%u) %-17s", time, (record.timestamp % 1000000000) / 1000, record.thread, Trace::event_name(record.event));
+
+    if (record.peer == UNKNOWN_PEER)
+        printf(" peer -");
+    else
+        printf(" peer %u", record.peer);
+
+    if ((TraceEvent) record.event == TraceEvent::MESSAGE_DELIVERED)
+        printf(" message %u (%u bytes)\n", record.msg_num, record.length);
+    else
+        printf(" %s %u/%u (%u bytes)\n", Trace::describe_flags(record.flags).c_str(), record.msg_num, record.frag_num, record.length);
+}
+
+static void print_csv(const TraceRecord& record)
+{
+    printf(
+        "%lu,%u,%s,%d,%u,%u,%s,%u\n",
+        record.timestamp,
+        record.thread,
+        Trace::event_name(record.event),
+        record.peer == UNKNOWN_PEER ? -1 : (int) record.peer,
+        record.msg_num,
+        record.frag_num,
+        Trace::describe_flags(record.flags).c_str(),
+        record.length
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "--csv")))
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    bool csv = argc == 3;
+
+    std::vector<TraceRecord> records;
+    if (!read_trace(argv[1], records))
+        return 1;
+
+    if (csv)
+        printf("timestamp_ns,thread,event,peer,msg_num,frag_num,flags,length\n");
+
+    for (const TraceRecord& record : records)
+        csv ? print_csv(record) : print_text(record);
+
+    return 0;
+}